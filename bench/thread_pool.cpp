@@ -0,0 +1,84 @@
+// Contention benchmark: the work-stealing TThreadPool against the single queue TLockingThreadPool.
+// Build with "make thread_pool_bench", run as "./thread_pool_bench [tasks] [threads]".
+
+#include "../src/locking_thread_pool.h"
+#include "../src/thread_pool.h"
+#include "../src/timer.h"
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+
+    // Roughly the cost of a cheap per-document step
+    uint64_t SmallWork(uint64_t seed) {
+        uint64_t value = seed;
+        for (size_t i = 0; i < 64; ++i) {
+            value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+        }
+        return value;
+    }
+
+    void Report(const std::string& name, size_t tasksCount, double elapsedMs) {
+        std::cout << std::left << std::setw(48) << name
+            << std::right << std::setw(10) << std::fixed << std::setprecision(1) << elapsedMs << " ms"
+            << std::setw(12) << static_cast<uint64_t>(tasksCount / (elapsedMs / 1000.0)) << " tasks/s"
+            << std::endl;
+    }
+
+    // One future per task, submitted by producersCount threads at once
+    template <class TPool>
+    void BenchEnqueue(const std::string& name, size_t tasksCount, size_t threadsCount, size_t producersCount) {
+        TPool pool(threadsCount);
+        std::atomic<uint64_t> checksum = 0;
+        TTimer<std::chrono::high_resolution_clock, std::chrono::microseconds> timer;
+        std::vector<std::thread> producers;
+        for (size_t p = 0; p < producersCount; ++p) {
+            producers.emplace_back([&, p] {
+                std::vector<std::future<uint64_t>> futures;
+                futures.reserve(tasksCount / producersCount);
+                for (size_t i = p; i < tasksCount; i += producersCount) {
+                    futures.push_back(pool.enqueue(SmallWork, i));
+                }
+                uint64_t sum = 0;
+                for (auto& future : futures) {
+                    sum += future.get();
+                }
+                checksum += sum;
+            });
+        }
+        for (std::thread& producer : producers) {
+            producer.join();
+        }
+        Report(name + ", " + std::to_string(producersCount) + " producer(s)", tasksCount, timer.Elapsed() / 1000.0);
+    }
+
+    void BenchParallelFor(size_t tasksCount, size_t threadsCount) {
+        TThreadPool pool(threadsCount);
+        std::vector<uint64_t> results(tasksCount);
+        TTimer<std::chrono::high_resolution_clock, std::chrono::microseconds> timer;
+        pool.parallel_for(0, tasksCount, [&results](size_t i) {
+            results[i] = SmallWork(i);
+        });
+        Report("TThreadPool::parallel_for", tasksCount, timer.Elapsed() / 1000.0);
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const size_t tasksCount = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    const size_t threadsCount = argc > 2 ? std::stoul(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    std::cout << tasksCount << " tasks, " << threadsCount << " threads" << std::endl;
+    std::vector<size_t> producersCounts = {1};
+    if (threadsCount > 1) {
+        producersCounts.push_back(threadsCount);
+    }
+    for (size_t producersCount : producersCounts) {
+        BenchEnqueue<TLockingThreadPool>("TLockingThreadPool::enqueue", tasksCount, threadsCount, producersCount);
+        BenchEnqueue<TThreadPool>("TThreadPool::enqueue", tasksCount, threadsCount, producersCount);
+    }
+    BenchParallelFor(tasksCount, threadsCount);
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <cmath>
 
@@ -13,60 +14,82 @@ void TAgencyRating::Load(const std::string& filePath, bool setMinAsUnk) {
         LOG_DEBUG("Rating file is not available");
         return;
     }
+    std::unordered_map<std::string, double> records;
     while (std::getline(rating, line)) {
         std::vector<std::string> lineSplitted;
         boost::split(lineSplitted, line, boost::is_any_of("\t"));
-        Records[lineSplitted[1]] = std::stod(lineSplitted[0]);
+        records[lineSplitted[1]] = std::stod(lineSplitted[0]);
     }
 
-    if (setMinAsUnk) {
-        UnkRating = std::min_element(Records.begin(), Records.end(),
+    if (setMinAsUnk && !records.empty()) {
+        UnkRating = std::min_element(records.begin(), records.end(),
             [](const std::pair<std::string, double>& item1, const std::pair<std::string, double>& item2) {
                 return item1.second < item2.second;
             }
         )->second;
     }
-}
 
-double TAgencyRating::ScoreUrl(const std::string& url) const {
-    const auto iter = Records.find(GetHost(url));
-    return (iter != Records.end()) ? iter->second : UnkRating;
+    THostDictionary& hosts = THostDictionary::Get();
+    std::vector<std::pair<THostId, double>> ratings;
+    ratings.reserve(records.size());
+    for (const auto& [host, value] : records) {
+        ratings.emplace_back(hosts.Intern(host), value);
+    }
+    Ratings.assign(hosts.Size(), UnkRating);
+    for (const auto& [host, value] : ratings) {
+        Ratings[host] = value;
+    }
 }
 
 void TAlexaAgencyRating::Load(const std::string& filePath) {
     std::ifstream fileStream(filePath);
     nlohmann::json json;
     fileStream >> json;
+
+    THostDictionary& hosts = THostDictionary::Get();
+    for (const nlohmann::json& agency : json) {
+        hosts.Intern(agency.at("host").get<std::string>());
+    }
+    RawRatings.assign(hosts.Size(), UnkRating);
+    CountryShares.assign(hosts.Size(), TCountryShares{});
+
     for (const nlohmann::json& agency : json) {
-        std::string host = agency.at("host").get<std::string>();
-        double rating = agency.at("rating").get<double>();
-        RawRating[host] = rating;
+        const THostId host = hosts.Intern(agency.at("host").get<std::string>());
+        RawRatings[host] = agency.at("rating").get<double>();
 
-        for (auto& [key, value] : agency.at("country").items()) {
-            CountryShare[host][key] = value;
+        const nlohmann::json& country = agency.at("country");
+        for (size_t c = 0; c < CC_COUNT; ++c) {
+            const auto it = country.find(COUNTRY_CODES[c]);
+            if (it != country.end()) {
+                CountryShares[host][c] = it->get<double>();
+            }
         }
     }
+    BuildScoreTables();
 }
 
-double TAlexaAgencyRating::GetCountryShare(const std::string& host, const std::string& code) const {
-    const auto iter = CountryShare.find(host);
-    if (iter == CountryShare.end()) {
-        return 0.;
-    }
-    const auto iter2 = iter->second.find(code);
-    if (iter2 == iter->second.end()) {
-        return 0.;
+void TAlexaAgencyRating::BuildScoreTables() {
+    // Id RawRatings.size() is out of the rating, so it gets the score of unknown hosts
+    const size_t tableSize = RawRatings.size() + 1;
+    const tg::ELanguage languages[] = {tg::LN_EN, tg::LN_RU};
+    for (size_t l = 0; l < std::size(languages); ++l) {
+        for (size_t s = 0; s < RATING_SHIFTS_COUNT; ++s) {
+            std::vector<double>& scores = LogScores[l][s];
+            scores.resize(tableSize);
+            for (size_t host = 0; host < tableSize; ++host) {
+                scores[host] = ScoreHost(host, languages[l], RT_LOG, RATING_SHIFTS[s]);
+            }
+        }
+        std::vector<double>& scores = RawScores[l];
+        scores.resize(tableSize);
+        for (size_t host = 0; host < tableSize; ++host) {
+            scores[host] = ScoreHost(host, languages[l], RT_RAW, 0.);
+        }
     }
-    return iter2->second;
-}
-
-double TAlexaAgencyRating::GetRawRating(const std::string& host) const {
-    const auto iter = RawRating.find(host);
-    return (iter != RawRating.end()) ? iter->second : UnkRating;
 }
 
-double TAlexaAgencyRating::ScoreUrl(
-    const std::string& host,
+double TAlexaAgencyRating::ScoreHost(
+    THostId host,
     tg::ELanguage language,
     ERatingType type,
     double shift
@@ -77,9 +100,9 @@ double TAlexaAgencyRating::ScoreUrl(
     double raw = GetRawRating(host);
     double coeff = 0;
     if (language == tg::LN_EN) {
-        coeff = (100. - GetCountryShare(host, "US") - GetCountryShare(host, "GB"))/100.;
+        coeff = (100. - GetCountryShare(host, CC_US) - GetCountryShare(host, CC_GB))/100.;
     } else {
-        coeff = GetCountryShare(host, "RU");
+        coeff = GetCountryShare(host, CC_RU);
     }
     if (type == RT_LOG) {
         return std::max(log(raw * coeff + shift), 0.3);
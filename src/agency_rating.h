@@ -1,9 +1,14 @@
 #pragma once
 
 #include "enum.pb.h"
+#include "host_dictionary.h"
 
+#include <algorithm>
+#include <array>
+#include <iterator>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <nlohmann_json/json.hpp>
 
 class TAgencyRating {
@@ -14,10 +19,13 @@ public:
     }
 
     void Load(const std::string& fileName, bool setMinAsUnk = false);
-    double ScoreUrl(const std::string& url) const;
+    double ScoreHost(THostId host) const {
+        return host < Ratings.size() ? Ratings[host] : UnkRating;
+    }
 
 private:
-     std::unordered_map<std::string, double> Records;
+     // Indexed by host id, hosts without a record have UnkRating
+     std::vector<double> Ratings;
      double UnkRating = 0.000015;
 };
 
@@ -27,6 +35,25 @@ enum ERatingType {
     RT_ONE = 2
 };
 
+// Countries used in ratings and cluster features
+enum ECountry {
+    CC_US = 0,
+    CC_GB = 1,
+    CC_IN = 2,
+    CC_RU = 3,
+    CC_CA = 4,
+    CC_AU = 5,
+    CC_COUNT = 6
+};
+
+constexpr const char* COUNTRY_CODES[CC_COUNT] = {"US", "GB", "IN", "RU", "CA", "AU"};
+
+using TCountryShares = std::array<double, CC_COUNT>;
+
+// Shifts with precomputed TAlexaAgencyRating scores
+constexpr double RATING_SHIFTS[] = {0., 1., 1.3, 1.6};
+constexpr size_t RATING_SHIFTS_COUNT = std::size(RATING_SHIFTS);
+
 class TAlexaAgencyRating {
 public:
     TAlexaAgencyRating() = default;
@@ -35,12 +62,43 @@ public:
     }
 
     void Load(const std::string& fileName);
-    double ScoreUrl(const std::string& host, tg::ELanguage language, ERatingType type, double shift) const;
-    double GetRawRating(const std::string& host) const;
-    double GetCountryShare(const std::string& host, const std::string& code) const;
+    double ScoreHost(THostId host, tg::ELanguage language, ERatingType type, double shift) const;
+    // Same as ScoreHost(host, Language, Type, RATING_SHIFTS[ShiftIndex]), read from a precomputed table
+    template <tg::ELanguage Language, ERatingType Type, size_t ShiftIndex>
+    double GetScore(THostId host) const;
+    double GetRawRating(THostId host) const {
+        return host < RawRatings.size() ? RawRatings[host] : UnkRating;
+    }
+    double GetCountryShare(THostId host, ECountry country) const {
+        return host < CountryShares.size() ? CountryShares[host][country] : 0.;
+    }
 
 private:
-     std::unordered_map<std::string, double> RawRating;
-     std::unordered_map<std::string, std::unordered_map<std::string, double>> CountryShare;
+     // Indexed by host id, hosts without a record have UnkRating
+     std::vector<double> RawRatings;
+     // Indexed by host id, shares of other countries are not stored
+     std::vector<TCountryShares> CountryShares;
      double UnkRating = 0.1;
+
+     // Scores for English and for other languages, indexed by host id.
+     // The last element is the score of hosts missing in the rating.
+     std::array<std::array<std::vector<double>, RATING_SHIFTS_COUNT>, 2> LogScores;
+     std::array<std::vector<double>, 2> RawScores;
+
+     void BuildScoreTables();
 };
+
+template <tg::ELanguage Language, ERatingType Type, size_t ShiftIndex>
+double TAlexaAgencyRating::GetScore(THostId host) const {
+    static_assert(ShiftIndex < RATING_SHIFTS_COUNT, "Shift is not in RATING_SHIFTS");
+    constexpr size_t languageIndex = (Language == tg::LN_EN) ? 0 : 1;
+    if constexpr (Type == RT_ONE) {
+        return 1.;
+    } else {
+        static_assert(Type == RT_LOG || Type == RT_RAW, "Unknown rating type");
+        const std::vector<double>& scores = (Type == RT_LOG)
+            ? LogScores[languageIndex][ShiftIndex]
+            : RawScores[languageIndex];
+        return scores[std::min<size_t>(host, scores.size() - 1)];
+    }
+}
@@ -0,0 +1,60 @@
+#include "annotation_cache.h"
+#include "util.h"
+
+TAnnotationCache::TAnnotationCache(const std::string& path, uint64_t fingerprint)
+    : Fingerprint(fingerprint)
+{
+    rocksdb::Options options;
+    options.IncreaseParallelism();
+    options.OptimizeLevelStyleCompaction();
+    options.create_if_missing = true;
+
+    rocksdb::DB* db;
+    const rocksdb::Status s = rocksdb::DB::Open(options, path, &db);
+    ENSURE(s.ok(), "Failed to open annotation cache: " << s.getState());
+    Db.reset(db);
+}
+
+bool TAnnotationCache::Get(uint64_t contentHash, const std::string& digest, std::optional<TDbDocument>& document) const {
+    std::string value;
+    const rocksdb::Status s = Db->Get(rocksdb::ReadOptions(), MakeKey(contentHash), &value);
+    if (!s.ok()) {
+        ENSURE(s.IsNotFound(), "Annotation cache read failed: " << s.getState());
+        return false;
+    }
+    if (value.compare(0, digest.size(), digest) != 0) {
+        LOG_DEBUG("Annotation cache hash collision");
+        return false;
+    }
+    value.erase(0, digest.size());
+    if (value.empty()) {
+        document = std::nullopt;
+        return true;
+    }
+    TDbDocument cached;
+    if (!TDbDocument::FromProtoString(value, &cached)) {
+        LOG_DEBUG("Broken annotation cache entry");
+        return false;
+    }
+    document = std::move(cached);
+    return true;
+}
+
+void TAnnotationCache::Put(uint64_t contentHash, const std::string& digest, const std::optional<TDbDocument>& document) const {
+    std::string value;
+    if (document) {
+        ENSURE(document->ToProtoString(&value), "Failed to serialize document");
+    }
+    value.insert(0, digest);
+    const rocksdb::Status s = Db->Put(rocksdb::WriteOptions(), MakeKey(contentHash), value);
+    ENSURE(s.ok(), "Annotation cache write failed: " << s.getState());
+}
+
+std::string TAnnotationCache::MakeKey(uint64_t contentHash) const {
+    std::string key(2 * sizeof(uint64_t), '\0');
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        key[i] = static_cast<char>(Fingerprint >> (8 * (7 - i)));
+        key[sizeof(uint64_t) + i] = static_cast<char>(contentHash >> (8 * (7 - i)));
+    }
+    return key;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "db_document.h"
+
+#include <rocksdb/db.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+
+// On-disk cache of annotation results for repeated runs over the same input.
+// Keys are (annotator fingerprint, content hash), values start with a digest of the content
+// that is compared on read, so hash collisions are misses. Documents dropped by the annotator
+// are stored as a bare digest.
+class TAnnotationCache {
+public:
+    TAnnotationCache(const std::string& path, uint64_t fingerprint);
+
+    // Returns false if there is no entry for this content
+    bool Get(uint64_t contentHash, const std::string& digest, std::optional<TDbDocument>& document) const;
+    void Put(uint64_t contentHash, const std::string& digest, const std::optional<TDbDocument>& document) const;
+
+private:
+    std::string MakeKey(uint64_t contentHash) const;
+
+private:
+    std::unique_ptr<rocksdb::DB> Db;
+    uint64_t Fingerprint = 0;
+};
@@ -6,15 +6,124 @@
 #include "nasty.h"
 #include "thread_pool.h"
 #include "timer.h"
+#include "tokenized_document.h"
 #include "util.h"
 
-#include <boost/algorithm/string/join.hpp>
+#include <drogon/utils/Utilities.h>
 #include <google/protobuf/text_format.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <algorithm>
+#include <condition_variable>
 #include <fcntl.h>
+#include <fstream>
+#include <mutex>
 #include <optional>
+#include <sys/stat.h>
+#include <thread>
 #include <tinyxml2/tinyxml2.h>
 
+namespace {
+
+// SAX handler that hands over items of a top-level JSON array one by one,
+// so that the whole array is never kept in memory
+class TJsonArrayReader : public nlohmann::json_sax<nlohmann::json> {
+public:
+    using TItemHandler = std::function<void(nlohmann::json&&)>;
+
+    explicit TJsonArrayReader(TItemHandler onItem)
+        : OnItem(std::move(onItem))
+    {
+    }
+
+    bool null() override { return Value([](auto& p) { return p.null(); }); }
+    bool boolean(bool val) override { return Value([&](auto& p) { return p.boolean(val); }); }
+    bool number_integer(number_integer_t val) override { return Value([&](auto& p) { return p.number_integer(val); }); }
+    bool number_unsigned(number_unsigned_t val) override { return Value([&](auto& p) { return p.number_unsigned(val); }); }
+    bool number_float(number_float_t val, const string_t& s) override { return Value([&](auto& p) { return p.number_float(val, s); }); }
+    bool string(string_t& val) override { return Value([&](auto& p) { return p.string(val); }); }
+    bool key(string_t& val) override { return Builder->key(val); }
+
+    bool start_object(std::size_t elements) override { return Start([&](auto& p) { return p.start_object(elements); }); }
+    bool end_object() override { return End([](auto& p) { return p.end_object(); }); }
+    bool start_array(std::size_t elements) override {
+        if (Depth == 0) {
+            Depth = 1;
+            return true;
+        }
+        return Start([&](auto& p) { return p.start_array(elements); });
+    }
+    bool end_array() override {
+        if (Depth == 1) {
+            Depth = 0;
+            return true;
+        }
+        return End([](auto& p) { return p.end_array(); });
+    }
+
+    bool parse_error(std::size_t position, const std::string& lastToken, const nlohmann::detail::exception& ex) override {
+        throw std::runtime_error("Bad json at " + std::to_string(position) + " near '" + lastToken + "': " + ex.what());
+    }
+
+private:
+    using TDomParser = nlohmann::detail::json_sax_dom_parser<nlohmann::json>;
+
+    template <class F>
+    bool Value(F&& f) {
+        ENSURE(Depth != 0, "Top-level json value is not an array");
+        if (Depth == 1) {
+            nlohmann::json item;
+            TDomParser parser(item);
+            f(parser);
+            OnItem(std::move(item));
+            return true;
+        }
+        return f(*Builder);
+    }
+
+    template <class F>
+    bool Start(F&& f) {
+        ENSURE(Depth != 0, "Top-level json value is not an array");
+        if (Depth == 1) {
+            Item = nlohmann::json();
+            Builder.emplace(Item);
+        }
+        ++Depth;
+        return f(*Builder);
+    }
+
+    template <class F>
+    bool End(F&& f) {
+        const bool result = f(*Builder);
+        --Depth;
+        if (Depth == 1) {
+            Builder.reset();
+            OnItem(std::move(Item));
+        }
+        return result;
+    }
+
+private:
+    TItemHandler OnItem;
+    size_t Depth = 0;
+    nlohmann::json Item;
+    std::optional<TDomParser> Builder;
+};
+
+// One input record of AnnotateAll: a parsed document, a raw JSON record or an HTML file path
+struct TInputRecord {
+    enum EKind {
+        IK_DOCUMENT,
+        IK_JSON,
+        IK_HTML_PATH
+    };
+
+    EKind Kind = IK_DOCUMENT;
+    TDocument Document;
+    std::string Text;
+};
+
+}
+
 static std::unique_ptr<TEmbedder> LoadEmbedder(tg::TEmbedderConfig config) {
     if (config.type() == tg::ET_FASTTEXT) {
         return std::make_unique<TFastTextEmbedder>(config);
@@ -29,19 +138,20 @@ TAnnotator::TAnnotator(
     const std::string& configPath,
     const std::vector<std::string>& languages,
     bool saveNotNews /*= false*/,
-    const std::string& mode /* = top */
+    const std::string& mode /* = top */,
+    const std::string& cachePath /* = "" */
 )
     : Tokenizer(onmt::Tokenizer::Mode::Conservative, onmt::Tokenizer::Flags::CaseFeature)
     , SaveNotNews(saveNotNews)
     , Mode(mode)
 {
-    ParseConfig(configPath);
+    Config = ParseConfig(configPath);
     SaveTexts = Config.save_texts() || (Mode == "json");
     ComputeNasty = Config.compute_nasty();
 
     LOG_DEBUG("Loading models...");
 
-    LanguageDetector.loadModel(Config.lang_detect());
+    LanguageDetector.Load(Config.lang_detect());
     LOG_DEBUG("FastText language detector loaded");
 
     for (const std::string& l : languages) {
@@ -55,7 +165,7 @@ TAnnotator::TAnnotator(
         if (Languages.find(language) == Languages.end()) {
             continue;
         }
-        CategoryDetectors[language].loadModel(modelConfig.path());
+        CategoryDetectors[language].Load(modelConfig.path());
         LOG_DEBUG("FastText " << ToString(language) << " category detector loaded");
     }
 
@@ -67,86 +177,243 @@ TAnnotator::TAnnotator(
         tg::EEmbeddingKey embeddingKey = embedderConfig.embedding_key();
         Embedders[{language, embeddingKey}] = LoadEmbedder(embedderConfig);
     }
+
+    if (!cachePath.empty()) {
+        Cache = std::make_unique<TAnnotationCache>(cachePath, CalcFingerprint());
+        LOG_DEBUG("Annotation cache opened");
+    }
 }
 
 std::vector<TDbDocument> TAnnotator::AnnotateAll(
     const std::vector<std::string>& fileNames,
     tg::EInputFormat inputFormat) const
 {
-    TThreadPool threadPool;
+    const auto source = [&fileNames](const TPathHandler& onPath) {
+        for (std::string path : fileNames) {
+            onPath(std::move(path));
+        }
+    };
     std::vector<TDbDocument> docs;
-    std::vector<std::future<std::optional<TDbDocument>>> futures;
-    if (inputFormat == tg::IF_JSON) {
-        std::vector<TDocument> parsedDocs;
-        for (const std::string& path: fileNames) {
-            std::ifstream fileStream(path);
-            nlohmann::json json;
-            fileStream >> json;
-            for (const nlohmann::json& obj : json) {
-                parsedDocs.emplace_back(obj);
-            }
+    AnnotateAll(source, inputFormat, [&docs](TDbDocument&& doc) {
+        docs.push_back(std::move(doc));
+    });
+    docs.shrink_to_fit();
+    return docs;
+}
+
+void TAnnotator::AnnotateAll(
+    const TPathSource& source,
+    tg::EInputFormat inputFormat,
+    const TDocumentSink& sink) const
+{
+    ENSURE(inputFormat == tg::IF_JSON || inputFormat == tg::IF_JSONL || inputFormat == tg::IF_HTML, "Bad input format");
+
+    // Reader thread -> batches -> shared thread pool -> this thread in input order.
+    // The reader fills the next batch while the current one is annotated and another one waits,
+    // so at most window records are parsed but not yet passed to sink.
+    const size_t window = Config.annotation_window() != 0 ? Config.annotation_window() : 4096;
+    const size_t batchSize = std::max<size_t>(window / 3, 1);
+
+    using TBatch = std::vector<TInputRecord>;
+    TBatch filling;
+    std::optional<TBatch> ready;
+    std::mutex mutex;
+    std::condition_variable hasSpace;
+    std::condition_variable hasResult;
+    bool isReaderDone = false;
+    bool isStopped = false;
+    std::exception_ptr readerError;
+
+    struct TStopReading {};
+    auto flush = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        hasSpace.wait(lock, [&] { return !ready || isStopped; });
+        if (isStopped) {
+            throw TStopReading();
         }
-        parsedDocs.shrink_to_fit();
-        docs.reserve(parsedDocs.size());
-        futures.reserve(parsedDocs.size());
-        for (const TDocument& parsedDoc: parsedDocs) {
-            futures.push_back(threadPool.enqueue(&TAnnotator::AnnotateDocument, this, parsedDoc));
-        }
-    } else if (inputFormat == tg::IF_JSONL) {
-        std::vector<TDocument> parsedDocs;
-        for (const std::string& path: fileNames) {
-            std::ifstream fileStream(path);
-            std::string record;
-            while (std::getline(fileStream, record)) {
-                parsedDocs.emplace_back(nlohmann::json::parse(record));
+        ready = std::move(filling);
+        filling = TBatch();
+        hasResult.notify_one();
+    };
+    auto push = [&](TInputRecord&& record) {
+        if (filling.empty()) {
+            filling.reserve(batchSize);
+        }
+        filling.push_back(std::move(record));
+        if (filling.size() == batchSize) {
+            flush();
+        }
+    };
+
+    std::thread reader([&] {
+        try {
+            source([&](std::string&& path) {
+                if (inputFormat == tg::IF_JSON) {
+                    std::ifstream fileStream(path);
+                    TJsonArrayReader arrayReader([&](nlohmann::json&& item) {
+                        if (Cache) {
+                            push(TInputRecord{TInputRecord::IK_JSON, {}, item.dump()});
+                        } else {
+                            push(TInputRecord{TInputRecord::IK_DOCUMENT, TDocument(item), {}});
+                        }
+                    });
+                    nlohmann::json::sax_parse(fileStream, &arrayReader);
+                } else if (inputFormat == tg::IF_JSONL) {
+                    std::ifstream fileStream(path);
+                    std::string record;
+                    while (std::getline(fileStream, record)) {
+                        push(TInputRecord{TInputRecord::IK_JSON, {}, std::move(record)});
+                    }
+                } else {
+                    push(TInputRecord{TInputRecord::IK_HTML_PATH, {}, std::move(path)});
+                }
+            });
+            if (!filling.empty()) {
+                flush();
             }
+        } catch (const TStopReading&) {
+        } catch (...) {
+            readerError = std::current_exception();
         }
-        parsedDocs.shrink_to_fit();
-        docs.reserve(parsedDocs.size());
-        futures.reserve(parsedDocs.size());
-        for (const TDocument& parsedDoc: parsedDocs) {
-            futures.push_back(threadPool.enqueue(&TAnnotator::AnnotateDocument, this, parsedDoc));
+        std::unique_lock<std::mutex> lock(mutex);
+        isReaderDone = true;
+        hasResult.notify_one();
+    });
+
+    const auto annotate = [this](const TInputRecord& record) -> std::optional<TDbDocument> {
+        switch (record.Kind) {
+            case TInputRecord::IK_DOCUMENT:
+                return AnnotateDocument(record.Document);
+            case TInputRecord::IK_JSON:
+                return AnnotateJson(record.Text);
+            case TInputRecord::IK_HTML_PATH:
+                return AnnotateHtml(record.Text);
         }
-    } else if (inputFormat == tg::IF_HTML) {
-        docs.reserve(fileNames.size());
-        futures.reserve(fileNames.size());
-        for (const std::string& path: fileNames) {
-            using TFunc = std::optional<TDbDocument>(TAnnotator::*)(const std::string&) const;
-            futures.push_back(threadPool.enqueue<TFunc>(&TAnnotator::AnnotateHtml, this, path));
+        return std::nullopt;
+    };
+
+    try {
+        std::vector<std::optional<TDbDocument>> docs;
+        while (true) {
+            TBatch batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                hasResult.wait(lock, [&] { return ready || isReaderDone; });
+                if (!ready) {
+                    break;
+                }
+                batch = std::move(ready.value());
+                ready.reset();
+            }
+            hasSpace.notify_one();
+            docs.clear();
+            docs.resize(batch.size());
+            TThreadPool::Get().parallel_map(batch.begin(), batch.end(), docs.begin(), annotate, /* grainSize */ 0, TP_BULK);
+            batch.clear();
+            for (std::optional<TDbDocument>& doc : docs) {
+                if (doc) {
+                    sink(std::move(doc.value()));
+                }
+            }
         }
-    } else {
-        ENSURE(false, "Bad input format");
-    }
-    for (auto& futureDoc : futures) {
-        std::optional<TDbDocument> doc = futureDoc.get();
-        if (!doc) {
-            continue;
+    } catch (...) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            isStopped = true;
         }
-        docs.push_back(std::move(doc.value()));
+        hasSpace.notify_one();
+        reader.join();
+        throw;
+    }
+    reader.join();
+    if (readerError) {
+        std::rethrow_exception(readerError);
     }
-    futures.clear();
-    docs.shrink_to_fit();
-    return docs;
 }
 
 std::optional<TDbDocument> TAnnotator::AnnotateHtml(const std::string& path) const {
-    std::optional<TDocument> parsedDoc = ParseHtml(path);
-    return parsedDoc ? AnnotateDocument(*parsedDoc) : std::nullopt;
+    tinyxml2::XMLDocument html;
+    if (!Cache) {
+        if (html.LoadFile(path.c_str()) != tinyxml2::XML_SUCCESS) {
+            LOG_DEBUG("Bad html: " << path);
+            return std::nullopt;
+        }
+        return AnnotateHtml(html, path);
+    }
+
+    std::ifstream fileStream(path, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(fileStream)), std::istreambuf_iterator<char>());
+    if (!fileStream) {
+        LOG_DEBUG("Bad html: " << path);
+        return std::nullopt;
+    }
+    return AnnotateCached(path, content, [&]() -> std::optional<TDbDocument> {
+        if (html.Parse(content.data(), content.size()) != tinyxml2::XML_SUCCESS) {
+            LOG_DEBUG("Bad html: " << path);
+            return std::nullopt;
+        }
+        return AnnotateHtml(html, path);
+    });
+}
+
+std::optional<TDbDocument> TAnnotator::AnnotateJson(const std::string& record) const {
+    const auto annotate = [&] {
+        return AnnotateDocument(TDocument(nlohmann::json::parse(record)));
+    };
+    return Cache ? AnnotateCached("", record, annotate) : annotate();
+}
+
+std::optional<TDbDocument> TAnnotator::AnnotateCached(const std::string& name, const std::string& content, const TAnnotateFunc& annotate) const {
+    // The 64-bit hash only finds the entry, the MD5 digests are checked on read
+    const uint64_t contentHash = CalcFnvHash(content, CalcFnvHash(name));
+    const std::string digest = drogon::utils::getMd5(name) + drogon::utils::getMd5(content);
+    std::optional<TDbDocument> document;
+    if (Cache->Get(contentHash, digest, document)) {
+        return document;
+    }
+    document = annotate();
+    Cache->Put(contentHash, digest, document);
+    return document;
 }
 
 std::optional<TDbDocument> TAnnotator::AnnotateHtml(const tinyxml2::XMLDocument& html, const std::string& fileName) const {
-    std::optional<TDocument> parsedDoc = ParseHtml(html, fileName);
-    return parsedDoc ? AnnotateDocument(*parsedDoc) : std::nullopt;
+    // Language detection needs only meta tags and the beginning of the text,
+    // so documents in other languages are dropped before the full extraction
+    TDocument document;
+    tg::ELanguage language = tg::LN_UNDEFINED;
+    try {
+        document.FromHtmlHead(html, fileName);
+        document.FromHtmlTextPrefix(html, LANGUAGE_DETECTION_TEXT_PREFIX);
+        language = DetectLanguage(LanguageDetector, document);
+        if (Languages.find(language) == Languages.end()) {
+            return std::nullopt;
+        }
+        document.FromHtmlBody(html, Config.parse_links());
+    } catch (...) {
+        LOG_DEBUG("Bad html: " << fileName);
+        return std::nullopt;
+    }
+    // Short documents are dropped like in AnnotateDocument, but "languages" mode lists them
+    if (Mode != "languages" && document.Text.length() < Config.min_text_length()) {
+        return std::nullopt;
+    }
+    return AnnotateDocument(document, language);
 }
 
 std::optional<TDbDocument> TAnnotator::AnnotateDocument(const TDocument& document) const {
-    TDbDocument dbDoc;
-    dbDoc.Language = DetectLanguage(LanguageDetector, document);
-    if (Languages.find(dbDoc.Language) == Languages.end()) {
+    const tg::ELanguage language = DetectLanguage(LanguageDetector, document);
+    if (Languages.find(language) == Languages.end()) {
         return std::nullopt;
     }
+    return AnnotateDocument(document, language);
+}
+
+std::optional<TDbDocument> TAnnotator::AnnotateDocument(const TDocument& document, tg::ELanguage language) const {
+    TDbDocument dbDoc;
+    dbDoc.Language = language;
     dbDoc.Url = document.Url;
     dbDoc.Host = GetHost(dbDoc.Url);
+    dbDoc.HostId = THostDictionary::Get().Intern(dbDoc.Host);
     dbDoc.SiteName = document.SiteName;
     dbDoc.Title = document.Title;
     dbDoc.FetchTime = document.FetchTime;
@@ -167,9 +434,8 @@ std::optional<TDbDocument> TAnnotator::AnnotateDocument(const TDocument& documen
         return std::nullopt;
     }
 
-    std::string cleanTitle = PreprocessText(document.Title);
-    std::string cleanText = PreprocessText(document.Text);
-    dbDoc.Category = DetectCategory(CategoryDetectors.at(dbDoc.Language), cleanTitle, cleanText);
+    const TTokenizedDocument tokenizedDoc(Tokenizer, document.Title, document.Text);
+    dbDoc.Category = DetectCategory(CategoryDetectors.at(dbDoc.Language), tokenizedDoc.GetAll());
     if (dbDoc.Category == tg::NC_UNDEFINED) {
         return std::nullopt;
     }
@@ -181,7 +447,7 @@ std::optional<TDbDocument> TAnnotator::AnnotateDocument(const TDocument& documen
         if (language != dbDoc.Language) {
             continue;
         }
-        TDbDocument::TEmbedding value = embedder->CalcEmbedding(cleanTitle, cleanText);
+        TDbDocument::TEmbedding value = embedder->CalcEmbedding(tokenizedDoc);
         dbDoc.Embeddings.emplace(embeddingKey, std::move(value));
     }
     if (ComputeNasty) {
@@ -191,41 +457,74 @@ std::optional<TDbDocument> TAnnotator::AnnotateDocument(const TDocument& documen
     return dbDoc;
 }
 
-std::optional<TDocument> TAnnotator::ParseHtml(const std::string& path) const {
-    TDocument doc;
-    try {
-        doc.FromHtml(path.c_str(), Config.parse_links());
-    } catch (...) {
-        LOG_DEBUG("Bad html: " << path);
-        return std::nullopt;
-    }
-    return doc;
+uint64_t TAnnotator::CalcFingerprint() const {
+    return CalcFingerprint(Config, Languages, SaveNotNews, Mode);
 }
 
-std::optional<TDocument> TAnnotator::ParseHtml(const tinyxml2::XMLDocument& html, const std::string& fileName) const {
-    TDocument doc;
-    try {
-        doc.FromHtml(html, fileName, Config.parse_links());
-    } catch (...) {
-        LOG_DEBUG("Bad html: " << fileName);
-        return std::nullopt;
-    }
-    if (doc.Text.length() < Config.min_text_length()) {
-        return std::nullopt;
+uint64_t TAnnotator::CalcFingerprint(
+    const std::string& configPath,
+    const std::vector<std::string>& languages,
+    bool saveNotNews,
+    const std::string& mode)
+{
+    std::unordered_set<tg::ELanguage> languageSet;
+    for (const std::string& l : languages) {
+        languageSet.insert(FromString<tg::ELanguage>(l));
     }
-    return doc;
+    return CalcFingerprint(ParseConfig(configPath), languageSet, saveNotNews, mode);
 }
 
-std::string TAnnotator::PreprocessText(const std::string& text) const {
-    std::vector<std::string> tokens;
-    Tokenizer.tokenize(text, tokens);
-    return boost::join(tokens, " ");
+uint64_t TAnnotator::CalcFingerprint(
+    const tg::TAnnotatorConfig& config,
+    const std::unordered_set<tg::ELanguage>& languageSet,
+    bool saveNotNews,
+    const std::string& mode)
+{
+    // Everything that can change annotation results: config, models, CLI options.
+    // Bump the version when the annotation code or the cache format changes.
+    std::string data = "version=2\n";
+    // Only controls pipelining
+    tg::TAnnotatorConfig hashedConfig = config;
+    hashedConfig.clear_annotation_window();
+    std::string configText;
+    google::protobuf::TextFormat::PrintToString(hashedConfig, &configText);
+    data += configText;
+    // Of all the modes only "json" (through save texts) and "languages" change annotation
+    const bool saveTexts = config.save_texts() || (mode == "json");
+    data += "\nsave_texts=" + std::to_string(saveTexts);
+    data += "\nlanguages_only=" + std::to_string(mode == "languages");
+    data += "\nsave_not_news=" + std::to_string(saveNotNews) + "\nlanguages=";
+    std::vector<int> languages(languageSet.begin(), languageSet.end());
+    std::sort(languages.begin(), languages.end());
+    for (const int language : languages) {
+        data += std::to_string(language) + ",";
+    }
+
+    std::vector<std::string> modelPaths = {config.lang_detect()};
+    for (const auto& modelConfig : config.category_models()) {
+        modelPaths.push_back(modelConfig.path());
+    }
+    for (const auto& embedderConfig : config.embedders()) {
+        modelPaths.push_back(embedderConfig.model_path());
+        modelPaths.push_back(embedderConfig.vector_model_path());
+        modelPaths.push_back(embedderConfig.vocabulary_path());
+    }
+    for (const std::string& path : modelPaths) {
+        struct stat st;
+        if (path.empty() || stat(path.c_str(), &st) != 0) {
+            continue;
+        }
+        data += "\n" + path + ":" + std::to_string(st.st_size) + ":" + std::to_string(st.st_mtime);
+    }
+    return CalcFnvHash(data);
 }
 
-void TAnnotator::ParseConfig(const std::string& fname) {
+tg::TAnnotatorConfig TAnnotator::ParseConfig(const std::string& fname) {
     const int fileDesc = open(fname.c_str(), O_RDONLY);
     ENSURE(fileDesc >= 0, "Could not open config file");
     google::protobuf::io::FileInputStream fileInput(fileDesc);
-    const bool success = google::protobuf::TextFormat::Parse(&fileInput, &Config);
+    tg::TAnnotatorConfig config;
+    const bool success = google::protobuf::TextFormat::Parse(&fileInput, &config);
     ENSURE(success, "Invalid prototxt file");
+    return config;
 }
@@ -1,16 +1,18 @@
 #pragma once
 
+#include "annotation_cache.h"
+#include "classifiers/ft_classifier.h"
 #include "config.pb.h"
 #include "db_document.h"
 #include "embedders/embedder.h"
 
+#include <functional>
 #include <memory>
 #include <optional>
 #include <unordered_set>
 #include <unordered_map>
 #include <vector>
 
-#include <fasttext.h>
 #include <onmt/Tokenizer.h>
 
 struct TDocument;
@@ -19,7 +21,7 @@ namespace tinyxml2 {
     class XMLDocument;
 }
 
-using TFTModelStorage = std::unordered_map<tg::ELanguage, fasttext::FastText>;
+using TFTModelStorage = std::unordered_map<tg::ELanguage, TFastTextClassifier>;
 
 class TAnnotator {
 public:
@@ -27,22 +29,48 @@ public:
         const std::string& configPath,
         const std::vector<std::string>& languages,
         bool saveNotNews = false,
-        const std::string& mode = "top");
+        const std::string& mode = "top",
+        const std::string& cachePath = "");
+
+    using TDocumentSink = std::function<void(TDbDocument&&)>;
+    using TPathHandler = std::function<void(std::string&&)>;
+    // Calls the handler for every input path, e.g. while a directory is still being listed
+    using TPathSource = std::function<void(const TPathHandler&)>;
 
     std::vector<TDbDocument> AnnotateAll(const std::vector<std::string>& fileNames, tg::EInputFormat inputFormat) const;
+    // Streams annotated documents to sink in input order, memory is bounded by annotation_window
+    void AnnotateAll(
+        const TPathSource& source,
+        tg::EInputFormat inputFormat,
+        const TDocumentSink& sink) const;
 
     std::optional<TDbDocument> AnnotateHtml(const std::string& path) const;
     std::optional<TDbDocument> AnnotateHtml(const tinyxml2::XMLDocument& html, const std::string& fileName) const;
 
-private:
-    std::optional<TDbDocument> AnnotateDocument(const TDocument& document) const;
+    // Hash of everything that can change annotation results: config, models, options
+    uint64_t CalcFingerprint() const;
+    // Same for an annotator with these constructor arguments, models are not loaded
+    static uint64_t CalcFingerprint(
+        const std::string& configPath,
+        const std::vector<std::string>& languages,
+        bool saveNotNews = false,
+        const std::string& mode = "top");
 
-    std::optional<TDocument> ParseHtml(const std::string& path) const;
-    std::optional<TDocument> ParseHtml(const tinyxml2::XMLDocument& html, const std::string& fileName) const;
+private:
+    using TAnnotateFunc = std::function<std::optional<TDbDocument>()>;
 
-    std::string PreprocessText(const std::string& text) const;
+    std::optional<TDbDocument> AnnotateJson(const std::string& record) const;
+    // Document name is a part of the output, so it is a part of the cache key too
+    std::optional<TDbDocument> AnnotateCached(const std::string& name, const std::string& content, const TAnnotateFunc& annotate) const;
+    std::optional<TDbDocument> AnnotateDocument(const TDocument& document) const;
+    std::optional<TDbDocument> AnnotateDocument(const TDocument& document, tg::ELanguage language) const;
 
-    void ParseConfig(const std::string& fname);
+    static uint64_t CalcFingerprint(
+        const tg::TAnnotatorConfig& config,
+        const std::unordered_set<tg::ELanguage>& languages,
+        bool saveNotNews,
+        const std::string& mode);
+    static tg::TAnnotatorConfig ParseConfig(const std::string& fname);
 
 private:
     tg::TAnnotatorConfig Config;
@@ -50,7 +78,7 @@ private:
     std::unordered_set<tg::ELanguage> Languages;
     onmt::Tokenizer Tokenizer;
 
-    fasttext::FastText LanguageDetector;
+    TFastTextClassifier LanguageDetector;
     TFTModelStorage CategoryDetectors;
     std::map<std::pair<tg::ELanguage, tg::EEmbeddingKey>, std::unique_ptr<TEmbedder>> Embedders;
 
@@ -58,4 +86,6 @@ private:
     bool SaveTexts = false;
     bool ComputeNasty = false;
     std::string Mode;
+
+    std::unique_ptr<TAnnotationCache> Cache;
 };
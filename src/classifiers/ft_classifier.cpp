@@ -0,0 +1,515 @@
+#include "ft_classifier.h"
+#include "../util.h"
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+// This file must be compiled without -ffast-math: every floating point operation below
+// mirrors fastText's own code (summation order included), so that probabilities
+// are bit-exact with fasttext::FastText::predictLine.
+
+namespace {
+
+constexpr int32_t FASTTEXT_MAGIC = 793712314;
+constexpr int32_t FASTTEXT_VERSION = 12;
+constexpr int32_t MODEL_SUPERVISED = 3;
+constexpr int32_t QUANTIZER_CENTROIDS = 256;
+
+constexpr int64_t SIGMOID_TABLE_SIZE = 512;
+constexpr int64_t MAX_SIGMOID = 8;
+
+const std::string EOS = "</s>";
+const std::string BOW = "<";
+const std::string EOW = ">";
+const std::string LABEL_PREFIX = "__label__";
+
+template <class T>
+void Read(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    ENSURE(in, "Unexpected end of fastText model");
+}
+
+template <class T>
+void Read(std::istream& in, std::vector<T>& values, size_t count) {
+    values.resize(count);
+    in.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+    ENSURE(in, "Unexpected end of fastText model");
+}
+
+float StdLog(float x) {
+    return std::log(x + 1e-5);
+}
+
+bool IsDelimiter(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f' || c == '\0';
+}
+
+using THeap = std::vector<std::pair<float, int32_t>>;
+
+bool ComparePairs(const std::pair<float, int32_t>& l, const std::pair<float, int32_t>& r) {
+    return l.first > r.first;
+}
+
+// Loss::findKBest and the leaf case of HierarchicalSoftmaxLoss::dfs with k = 1
+void PushToHeap(THeap& heap, float score, int32_t id) {
+    heap.emplace_back(score, id);
+    std::push_heap(heap.begin(), heap.end(), ComparePairs);
+    if (heap.size() > 1) {
+        std::pop_heap(heap.begin(), heap.end(), ComparePairs);
+        heap.pop_back();
+    }
+}
+
+struct TScratch {
+    std::vector<int32_t> Ids;
+    std::vector<int32_t> WordHashes;
+    std::vector<float> Hidden;
+    std::vector<float> Output;
+    THeap Heap;
+};
+
+thread_local TScratch Scratch;
+
+} // namespace
+
+void TFastTextMatrix::TProductQuantizer::Load(std::istream& in) {
+    Read(in, Dim);
+    Read(in, SubquantizersCount);
+    Read(in, SubDim);
+    Read(in, LastSubDim);
+    Read(in, Centroids, static_cast<size_t>(Dim) * QUANTIZER_CENTROIDS);
+}
+
+const float* TFastTextMatrix::TProductQuantizer::GetCentroids(int32_t m, uint8_t code) const {
+    if (m == SubquantizersCount - 1) {
+        return &Centroids[m * QUANTIZER_CENTROIDS * SubDim + code * LastSubDim];
+    }
+    return &Centroids[(m * QUANTIZER_CENTROIDS + code) * SubDim];
+}
+
+void TFastTextMatrix::Load(std::istream& in, bool quantized) {
+    Quantized = quantized;
+    if (!Quantized) {
+        Read(in, Rows);
+        Read(in, Cols);
+        Read(in, Data, Rows * Cols);
+        return;
+    }
+    Read(in, QuantizedNorm);
+    Read(in, Rows);
+    Read(in, Cols);
+    int32_t codesSize = 0;
+    Read(in, codesSize);
+    Read(in, Codes, codesSize);
+    Quantizer.Load(in);
+    if (QuantizedNorm) {
+        Read(in, NormCodes, Rows);
+        NormQuantizer.Load(in);
+    }
+}
+
+float TFastTextMatrix::GetRowNorm(int64_t i) const {
+    return QuantizedNorm ? NormQuantizer.GetCentroids(0, NormCodes[i])[0] : 1.0f;
+}
+
+void TFastTextMatrix::AddRowToVector(float* x, int64_t i) const {
+    if (!Quantized) {
+        Eigen::Map<Eigen::VectorXf> vector(x, Cols);
+        vector += Eigen::Map<const Eigen::VectorXf>(Data.data() + i * Cols, Cols);
+        return;
+    }
+    const float norm = GetRowNorm(i);
+    const uint8_t* code = Codes.data() + Quantizer.SubquantizersCount * i;
+    int32_t subDim = Quantizer.SubDim;
+    for (int32_t m = 0; m < Quantizer.SubquantizersCount; m++) {
+        if (m == Quantizer.SubquantizersCount - 1) {
+            subDim = Quantizer.LastSubDim;
+        }
+        Eigen::Map<Eigen::VectorXf> vector(x + m * Quantizer.SubDim, subDim);
+        vector += norm * Eigen::Map<const Eigen::VectorXf>(Quantizer.GetCentroids(m, code[m]), subDim);
+    }
+}
+
+float TFastTextMatrix::DotRow(const float* x, int64_t i) const {
+    if (!Quantized) {
+        const float* row = Data.data() + i * Cols;
+        float result = 0.0f;
+        for (int64_t j = 0; j < Cols; j++) {
+            result += row[j] * x[j];
+        }
+        return result;
+    }
+    const float norm = GetRowNorm(i);
+    const uint8_t* code = Codes.data() + Quantizer.SubquantizersCount * i;
+    int32_t subDim = Quantizer.SubDim;
+    float result = 0.0f;
+    for (int32_t m = 0; m < Quantizer.SubquantizersCount; m++) {
+        const float* centroids = Quantizer.GetCentroids(m, code[m]);
+        if (m == Quantizer.SubquantizersCount - 1) {
+            subDim = Quantizer.LastSubDim;
+        }
+        for (int32_t n = 0; n < subDim; n++) {
+            result += x[m * Quantizer.SubDim + n] * centroids[n];
+        }
+    }
+    return result * norm;
+}
+
+void TFastTextClassifier::Load(const std::string& modelPath) {
+    std::ifstream in(modelPath, std::ifstream::binary);
+    ENSURE(in.is_open(), "Can't open fastText model: " << modelPath);
+
+    int32_t magic = 0;
+    int32_t version = 0;
+    Read(in, magic);
+    Read(in, version);
+    ENSURE(magic == FASTTEXT_MAGIC && version <= FASTTEXT_VERSION, "Wrong fastText model format: " << modelPath);
+
+    int32_t ws, epoch, minCount, neg, loss, model, lrUpdateRate;
+    double samplingThreshold;
+    Read(in, Dim);
+    Read(in, ws);
+    Read(in, epoch);
+    Read(in, minCount);
+    Read(in, neg);
+    Read(in, WordNgrams);
+    Read(in, loss);
+    Read(in, model);
+    Read(in, Bucket);
+    Read(in, MinN);
+    Read(in, MaxN);
+    Read(in, lrUpdateRate);
+    Read(in, samplingThreshold);
+    ENSURE(model == MODEL_SUPERVISED, "Not a supervised fastText model: " << modelPath);
+    ENSURE(loss >= 1 && loss <= 4, "Unknown fastText loss: " << loss);
+    Loss = static_cast<ELoss>(loss);
+    if (version == 11) {
+        // Old supervised models do not use char ngrams
+        MaxN = 0;
+    }
+
+    LoadDictionary(in);
+
+    bool quantizedInput = false;
+    Read(in, quantizedInput);
+    Input.Load(in, quantizedInput);
+    ENSURE(quantizedInput || PruneIndexSize < 0, "Invalid fastText model: pruned dictionary for a dense matrix");
+
+    bool quantizedOutput = false;
+    Read(in, quantizedOutput);
+    Output.Load(in, quantizedInput && quantizedOutput);
+    ENSURE(Input.GetCols() == Dim && Output.GetCols() == Dim, "Invalid fastText model dimensions");
+
+    if (Loss == ELoss::HierarchicalSoftmax) {
+        BuildTree();
+    } else if (Loss == ELoss::NegativeSampling || Loss == ELoss::OneVsAll) {
+        BuildSigmoidTable();
+    }
+}
+
+void TFastTextClassifier::LoadDictionary(std::istream& in) {
+    int32_t size = 0;
+    int64_t tokensCount = 0;
+    Read(in, size);
+    Read(in, WordsCount);
+    Read(in, LabelsCount);
+    Read(in, tokensCount);
+    Read(in, PruneIndexSize);
+
+    Entries.resize(size);
+    for (TEntry& entry : Entries) {
+        std::getline(in, entry.Word, '\0');
+        int8_t type = 0;
+        Read(in, entry.Count);
+        Read(in, type);
+        entry.IsLabel = (type == 1);
+        if (entry.IsLabel) {
+            Labels.push_back(entry.Word.substr(LABEL_PREFIX.length()));
+        }
+    }
+    ENSURE(static_cast<int32_t>(Labels.size()) == LabelsCount, "Invalid fastText dictionary");
+
+    PruneIndex.resize(std::max<int64_t>(PruneIndexSize, 0));
+    for (auto& [from, to] : PruneIndex) {
+        Read(in, from);
+        Read(in, to);
+    }
+    std::sort(PruneIndex.begin(), PruneIndex.end());
+
+    WordToEntry.assign(static_cast<int32_t>(std::ceil(size / 0.7)), -1);
+    for (int32_t i = 0; i < size; i++) {
+        WordToEntry[FindSlot(Entries[i].Word, Hash(Entries[i].Word))] = i;
+    }
+
+    if (MaxN <= 0) {
+        return;
+    }
+    SubwordOffsets.reserve(size + 1);
+    SubwordOffsets.push_back(0);
+    for (int32_t i = 0; i < size; i++) {
+        Subwords.push_back(i);
+        if (Entries[i].Word != EOS) {
+            ComputeSubwords(BOW + Entries[i].Word + EOW, Subwords);
+        }
+        SubwordOffsets.push_back(Subwords.size());
+    }
+}
+
+// HierarchicalSoftmaxLoss::buildTree
+void TFastTextClassifier::BuildTree() {
+    const int32_t size = LabelsCount;
+    Tree.assign(2 * size - 1, TTreeNode{-1, -1, static_cast<int64_t>(1e15)});
+    for (int32_t i = 0, labelIndex = 0; i < static_cast<int32_t>(Entries.size()); i++) {
+        if (Entries[i].IsLabel) {
+            Tree[labelIndex++].Count = Entries[i].Count;
+        }
+    }
+    int32_t leaf = size - 1;
+    int32_t node = size;
+    for (int32_t i = size; i < 2 * size - 1; i++) {
+        int32_t mini[2] = {0};
+        for (int32_t j = 0; j < 2; j++) {
+            if (leaf >= 0 && Tree[leaf].Count < Tree[node].Count) {
+                mini[j] = leaf--;
+            } else {
+                mini[j] = node++;
+            }
+        }
+        Tree[i].Left = mini[0];
+        Tree[i].Right = mini[1];
+        Tree[i].Count = Tree[mini[0]].Count + Tree[mini[1]].Count;
+    }
+}
+
+void TFastTextClassifier::BuildSigmoidTable() {
+    SigmoidTable.reserve(SIGMOID_TABLE_SIZE + 1);
+    for (int i = 0; i < SIGMOID_TABLE_SIZE + 1; i++) {
+        float x = static_cast<float>(i * 2 * MAX_SIGMOID) / SIGMOID_TABLE_SIZE - MAX_SIGMOID;
+        SigmoidTable.push_back(1.0 / (1.0 + std::exp(-x)));
+    }
+}
+
+float TFastTextClassifier::Sigmoid(float x) const {
+    if (x < -MAX_SIGMOID) {
+        return 0.0f;
+    } else if (x > MAX_SIGMOID) {
+        return 1.0f;
+    }
+    int64_t i = static_cast<int64_t>((x + MAX_SIGMOID) * SIGMOID_TABLE_SIZE / MAX_SIGMOID / 2);
+    return SigmoidTable[i];
+}
+
+uint32_t TFastTextClassifier::Hash(std::string_view word) {
+    uint32_t h = 2166136261;
+    for (char c : word) {
+        h = h ^ static_cast<uint32_t>(static_cast<int8_t>(c));
+        h = h * 16777619;
+    }
+    return h;
+}
+
+int32_t TFastTextClassifier::FindSlot(std::string_view word, uint32_t hash) const {
+    const int32_t size = WordToEntry.size();
+    int32_t slot = hash % size;
+    while (WordToEntry[slot] != -1 && Entries[WordToEntry[slot]].Word != word) {
+        slot = (slot + 1) % size;
+    }
+    return slot;
+}
+
+int32_t TFastTextClassifier::GetWordId(std::string_view word, uint32_t hash) const {
+    return WordToEntry[FindSlot(word, hash)];
+}
+
+void TFastTextClassifier::PushHash(std::vector<int32_t>& ids, int32_t id) const {
+    if (PruneIndexSize == 0 || id < 0) {
+        return;
+    }
+    if (PruneIndexSize > 0) {
+        auto it = std::lower_bound(PruneIndex.begin(), PruneIndex.end(), std::make_pair(id, INT32_MIN));
+        if (it == PruneIndex.end() || it->first != id) {
+            return;
+        }
+        id = it->second;
+    }
+    ids.push_back(WordsCount + id);
+}
+
+void TFastTextClassifier::ComputeSubwords(std::string_view word, std::vector<int32_t>& ids) const {
+    for (size_t i = 0; i < word.size(); i++) {
+        if ((word[i] & 0xC0) == 0x80) {
+            continue;
+        }
+        for (size_t j = i, n = 1; j < word.size() && n <= static_cast<size_t>(MaxN); n++) {
+            j++;
+            while (j < word.size() && (word[j] & 0xC0) == 0x80) {
+                j++;
+            }
+            if (n >= static_cast<size_t>(MinN) && !(n == 1 && (i == 0 || j == word.size()))) {
+                int32_t h = Hash(word.substr(i, j - i)) % Bucket;
+                PushHash(ids, h);
+            }
+        }
+    }
+}
+
+void TFastTextClassifier::AddSubwords(std::vector<int32_t>& ids, std::string_view token, int32_t wordId) const {
+    if (wordId < 0) {
+        if (MaxN > 0 && token != EOS) {
+            std::string word;
+            word.reserve(token.size() + BOW.size() + EOW.size());
+            word.append(BOW).append(token).append(EOW);
+            ComputeSubwords(word, ids);
+        }
+    } else if (MaxN <= 0) {
+        ids.push_back(wordId);
+    } else {
+        ids.insert(ids.end(), Subwords.begin() + SubwordOffsets[wordId], Subwords.begin() + SubwordOffsets[wordId + 1]);
+    }
+}
+
+// Dictionary::getLine for supervised models
+void TFastTextClassifier::GetInputIds(
+    TTokenSpan tokens,
+    std::vector<int32_t>& ids,
+    std::vector<int32_t>& wordHashes) const
+{
+    ids.clear();
+    wordHashes.clear();
+    for (const std::string_view& token : tokens) {
+        const uint32_t h = Hash(token);
+        const int32_t wordId = GetWordId(token, h);
+        const bool isLabel = wordId < 0 ? token.substr(0, LABEL_PREFIX.size()) == LABEL_PREFIX : Entries[wordId].IsLabel;
+        if (!isLabel) {
+            AddSubwords(ids, token, wordId);
+            wordHashes.push_back(h);
+        }
+        if (token == EOS) {
+            break;
+        }
+    }
+    for (int32_t i = 0; i < static_cast<int32_t>(wordHashes.size()); i++) {
+        uint64_t h = wordHashes[i];
+        for (int32_t j = i + 1; j < static_cast<int32_t>(wordHashes.size()) && j < i + WordNgrams; j++) {
+            h = h * 116049371 + wordHashes[j];
+            PushHash(ids, h % Bucket);
+        }
+    }
+}
+
+void TFastTextClassifier::ComputeHidden(const std::vector<int32_t>& ids, float* hidden) const {
+    Eigen::Map<Eigen::VectorXf> vector(hidden, Dim);
+    vector.setZero();
+    for (int32_t id : ids) {
+        Input.AddRowToVector(hidden, id);
+    }
+    vector *= static_cast<float>(1.0 / ids.size());
+}
+
+void TFastTextClassifier::ComputeOutput(float* output) const {
+    const int64_t size = Output.GetRows();
+    if (Loss == ELoss::Softmax) {
+        float max = output[0];
+        float z = 0.0f;
+        for (int64_t i = 0; i < size; i++) {
+            max = std::max(output[i], max);
+        }
+        for (int64_t i = 0; i < size; i++) {
+            output[i] = ::exp(static_cast<double>(output[i] - max));
+            z += output[i];
+        }
+        for (int64_t i = 0; i < size; i++) {
+            output[i] /= z;
+        }
+        return;
+    }
+    for (int64_t i = 0; i < size; i++) {
+        output[i] = Sigmoid(output[i]);
+    }
+}
+
+std::optional<TFastTextPrediction> TFastTextClassifier::FindBest(const float* output, float threshold) const {
+    THeap& heap = Scratch.Heap;
+    heap.clear();
+    for (int32_t i = 0; i < Output.GetRows(); i++) {
+        if (output[i] < threshold) {
+            continue;
+        }
+        if (!heap.empty() && StdLog(output[i]) < heap.front().first) {
+            continue;
+        }
+        PushToHeap(heap, StdLog(output[i]), i);
+    }
+    if (heap.empty()) {
+        return std::nullopt;
+    }
+    return TFastTextPrediction{heap.front().second, std::exp(heap.front().first)};
+}
+
+void TFastTextClassifier::Dfs(
+    float threshold,
+    int32_t node,
+    float score,
+    std::vector<std::pair<float, int32_t>>& heap,
+    const float* hidden) const
+{
+    if (score < StdLog(threshold)) {
+        return;
+    }
+    if (!heap.empty() && score < heap.front().first) {
+        return;
+    }
+    if (Tree[node].Left == -1 && Tree[node].Right == -1) {
+        PushToHeap(heap, score, node);
+        return;
+    }
+    float f = Output.DotRow(hidden, node - LabelsCount);
+    f = 1. / (1 + std::exp(-f));
+    Dfs(threshold, Tree[node].Left, score + StdLog(static_cast<float>(1.0 - f)), heap, hidden);
+    Dfs(threshold, Tree[node].Right, score + StdLog(f), heap, hidden);
+}
+
+std::optional<TFastTextPrediction> TFastTextClassifier::Predict(TTokenSpan tokens, float threshold) const {
+    GetInputIds(tokens, Scratch.Ids, Scratch.WordHashes);
+    if (Scratch.Ids.empty()) {
+        return std::nullopt;
+    }
+    std::vector<float>& hidden = Scratch.Hidden;
+    hidden.resize(Dim);
+    ComputeHidden(Scratch.Ids, hidden.data());
+
+    if (Loss == ELoss::HierarchicalSoftmax) {
+        THeap& heap = Scratch.Heap;
+        heap.clear();
+        Dfs(threshold, 2 * LabelsCount - 2, 0.0f, heap, hidden.data());
+        if (heap.empty()) {
+            return std::nullopt;
+        }
+        return TFastTextPrediction{heap.front().second, std::exp(heap.front().first)};
+    }
+
+    const int64_t outputSize = Output.GetRows();
+    std::vector<float>& output = Scratch.Output;
+    output.resize(outputSize);
+    for (int64_t row = 0; row < outputSize; row++) {
+        output[row] = Output.DotRow(hidden.data(), row);
+    }
+    ComputeOutput(output.data());
+    return FindBest(output.data(), threshold);
+}
+
+void TFastTextClassifier::Tokenize(std::string_view text, std::vector<std::string_view>& tokens) {
+    size_t begin = 0;
+    for (size_t i = 0; i <= text.size(); i++) {
+        if (i < text.size() && !IsDelimiter(text[i])) {
+            continue;
+        }
+        if (i > begin) {
+            tokens.push_back(text.substr(begin, i - begin));
+        }
+        begin = i + 1;
+    }
+}
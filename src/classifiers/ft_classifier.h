@@ -0,0 +1,147 @@
+#pragma once
+
+#include "../token_span.h"
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Input or output matrix of a fastText model, either dense or product-quantized
+class TFastTextMatrix {
+public:
+    void Load(std::istream& in, bool quantized);
+
+    int64_t GetRows() const { return Rows; }
+    int64_t GetCols() const { return Cols; }
+
+    // x += row(i)
+    void AddRowToVector(float* x, int64_t i) const;
+    // <x, row(i)>, accumulated in the same order as fasttext::Matrix::dotRow
+    float DotRow(const float* x, int64_t i) const;
+
+private:
+    struct TProductQuantizer {
+        int32_t Dim = 0;
+        int32_t SubquantizersCount = 0;
+        int32_t SubDim = 0;
+        int32_t LastSubDim = 0;
+        std::vector<float> Centroids;
+
+        void Load(std::istream& in);
+        const float* GetCentroids(int32_t m, uint8_t code) const;
+    };
+
+    float GetRowNorm(int64_t i) const;
+
+private:
+    bool Quantized = false;
+    int64_t Rows = 0;
+    int64_t Cols = 0;
+
+    // Dense
+    std::vector<float> Data;
+
+    // Quantized
+    bool QuantizedNorm = false;
+    std::vector<uint8_t> Codes;
+    std::vector<uint8_t> NormCodes;
+    TProductQuantizer Quantizer;
+    TProductQuantizer NormQuantizer;
+};
+
+struct TFastTextPrediction {
+    int32_t LabelId = -1;
+    float Probability = 0.0f;
+};
+
+// Inference-only reimplementation of fastText supervised models (.bin and quantized .ftz).
+// Predictions are bit-exact with fasttext::FastText::predictLine(in, predictions, 1, threshold)
+// when the input tokens are the whitespace-separated words of the line.
+class TFastTextClassifier {
+public:
+    TFastTextClassifier() = default;
+    explicit TFastTextClassifier(const std::string& modelPath) {
+        Load(modelPath);
+    }
+
+    void Load(const std::string& modelPath);
+
+    std::optional<TFastTextPrediction> Predict(TTokenSpan tokens, float threshold) const;
+
+    // Label without the "__label__" prefix
+    const std::string& GetLabel(int32_t labelId) const { return Labels.at(labelId); }
+    int32_t GetDimension() const { return Dim; }
+
+    // Splits text into words exactly like fastText does, treating newlines as plain spaces
+    static void Tokenize(std::string_view text, std::vector<std::string_view>& tokens);
+
+private:
+    enum class ELoss : int32_t {
+        HierarchicalSoftmax = 1,
+        NegativeSampling = 2,
+        Softmax = 3,
+        OneVsAll = 4
+    };
+
+    struct TEntry {
+        std::string Word;
+        int64_t Count = 0;
+        bool IsLabel = false;
+    };
+
+    struct TTreeNode {
+        int32_t Left = -1;
+        int32_t Right = -1;
+        int64_t Count = 0;
+    };
+
+    void LoadDictionary(std::istream& in);
+    void BuildTree();
+    void BuildSigmoidTable();
+
+    static uint32_t Hash(std::string_view word);
+    int32_t FindSlot(std::string_view word, uint32_t hash) const;
+    int32_t GetWordId(std::string_view word, uint32_t hash) const;
+
+    void PushHash(std::vector<int32_t>& ids, int32_t id) const;
+    void AddSubwords(std::vector<int32_t>& ids, std::string_view token, int32_t wordId) const;
+    void ComputeSubwords(std::string_view word, std::vector<int32_t>& ids) const;
+    void GetInputIds(TTokenSpan tokens, std::vector<int32_t>& ids, std::vector<int32_t>& wordHashes) const;
+
+    void ComputeHidden(const std::vector<int32_t>& ids, float* hidden) const;
+    void ComputeOutput(float* output) const;
+    float Sigmoid(float x) const;
+    std::optional<TFastTextPrediction> FindBest(const float* output, float threshold) const;
+    void Dfs(float threshold, int32_t node, float score, std::vector<std::pair<float, int32_t>>& heap, const float* hidden) const;
+
+private:
+    // Model arguments
+    int32_t Dim = 0;
+    int32_t WordNgrams = 1;
+    ELoss Loss = ELoss::Softmax;
+    int32_t Bucket = 0;
+    int32_t MinN = 0;
+    int32_t MaxN = 0;
+
+    // Dictionary
+    int32_t WordsCount = 0;
+    int32_t LabelsCount = 0;
+    int64_t PruneIndexSize = -1;
+    std::vector<TEntry> Entries;
+    std::vector<int32_t> WordToEntry;
+    std::vector<std::pair<int32_t, int32_t>> PruneIndex;
+    std::vector<int32_t> SubwordOffsets;
+    std::vector<int32_t> Subwords;
+    std::vector<std::string> Labels;
+
+    // Weights
+    TFastTextMatrix Input;
+    TFastTextMatrix Output;
+
+    // Loss-specific data
+    std::vector<TTreeNode> Tree;
+    std::vector<float> SigmoidTable;
+};
@@ -6,14 +6,43 @@
 #include <boost/range/algorithm/nth_element.hpp>
 #include <Eigen/Core>
 
+#include <array>
 #include <cassert>
 #include <cmath>
-#include <set>
+#include <iterator>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+TNewsCluster TNewsCluster::FromProto(const tg::TNewsClusterProto& proto, const std::vector<TDbDocument>& documents) {
+    TNewsCluster cluster(proto.id());
+    for (const uint32_t index : proto.documents()) {
+        ENSURE(index < documents.size(), "Bad document index in cluster proto");
+        cluster.AddDocument(documents[index]);
+    }
+    cluster.Category = proto.category();
+    cluster.BestTimestamp = proto.best_timestamp();
+    cluster.Importance = proto.importance();
+    return cluster;
+}
+
+tg::TNewsClusterProto TNewsCluster::ToProto(const std::vector<TDbDocument>& documents) const {
+    tg::TNewsClusterProto proto;
+    proto.set_id(Id);
+    proto.set_category(Category);
+    proto.set_best_timestamp(BestTimestamp);
+    proto.set_importance(Importance);
+    for (const TDbDocument& doc : Documents) {
+        assert(&doc >= documents.data() && &doc < documents.data() + documents.size());
+        proto.add_documents(static_cast<uint32_t>(&doc - documents.data()));
+    }
+    return proto;
+}
+
 void TNewsCluster::AddDocument(const TDbDocument& document) {
-    Documents.push_back(std::move(document));
-    FreshestTimestamp = std::max(FreshestTimestamp, static_cast<uint64_t>(Documents.back().FetchTime));
+    Documents.push_back(std::cref(document));
+    FreshestTimestamp = std::max(FreshestTimestamp, static_cast<uint64_t>(document.FetchTime));
 }
 
 uint64_t TNewsCluster::GetTimestamp(float percentile) const {
@@ -28,26 +57,30 @@ uint64_t TNewsCluster::GetTimestamp(float percentile) const {
     return clusterTimestamps[index];
 }
 
-void TNewsCluster::Summarize(const TAgencyRating& agencyRating) {
+void TNewsCluster::Summarize(const TAgencyRating& agencyRating, const TLanguageDocuments& langDocs) {
     assert(GetSize() != 0);
-    const size_t embeddingSize = Documents.back().Embeddings.at(tg::EK_FASTTEXT_CLASSIC).size();
-    Eigen::MatrixXf points(GetSize(), embeddingSize);
-    for (size_t i = 0; i < GetSize(); i++) {
-        auto embedding = Documents[i].Embeddings.at(tg::EK_FASTTEXT_CLASSIC);
-        Eigen::Map<Eigen::VectorXf, Eigen::Unaligned> eigenVector(embedding.data(), embedding.size());
-        points.row(i) = eigenVector / eigenVector.norm();
+    if (GetSize() == 1) {
+        // Nothing to reorder, the centroid is the document itself
+        const auto embedding = langDocs.GetEmbedding(Documents.front());
+        Centroid.assign(embedding.data(), embedding.data() + embedding.size());
+        return;
+    }
+
+    // Mean cosine of a document to all cluster documents is its dot product with the mean of normalized embeddings
+    Eigen::VectorXf meanPoint = Eigen::VectorXf::Zero(langDocs.Embeddings.GetEmbeddingSize());
+    for (const TDbDocument& doc : Documents) {
+        meanPoint += langDocs.GetEmbedding(doc);
     }
-    Eigen::MatrixXf docsCosine = points * points.transpose();
+    meanPoint /= static_cast<float>(GetSize());
 
     std::vector<double> weights;
     weights.reserve(GetSize());
     uint64_t freshestTimestamp = GetFreshestTimestamp();
-    for (size_t i = 0; i < GetSize(); ++i) {
-        const TDbDocument& doc = Documents[i];
-        double docRelevance = docsCosine.row(i).mean();
+    for (const TDbDocument& doc : Documents) {
+        double docRelevance = langDocs.GetEmbedding(doc).dot(meanPoint);
         int64_t timeDiff = static_cast<int64_t>(doc.FetchTime) - static_cast<int64_t>(freshestTimestamp);
         double timeMultiplier = Sigmoid(static_cast<double>(timeDiff) / 3600.0 + 12.0);
-        double agencyScore = agencyRating.ScoreUrl(doc.Url);
+        double agencyScore = agencyRating.ScoreHost(doc.HostId);
         double weight = (agencyScore + docRelevance) * timeMultiplier;
         if (doc.Nasty) {
             weight *= 0.5;
@@ -55,124 +88,212 @@ void TNewsCluster::Summarize(const TAgencyRating& agencyRating) {
         weights.push_back(weight);
     }
     SortByWeights(weights);
-}
 
-void TNewsCluster::CalcFeatures(
-    const TAlexaAgencyRating& alexaRating,
-    const std::vector<TDbDocument>& docs)
-{
-    Features.reserve(3*4*6 + 2*4*6);
-    const char* codes[] = {"US", "GB", "IN", "RU", "CA", "AU"};
-    const double decays[] = {1800., 3600., 7200., 86400.};
-    const double shifts[] = {1., 1.3, 1.6};
-    for (double shift : shifts) {
-        for (double decay : decays) {
-            auto slice = CalcImportance(alexaRating, docs, tg::LN_EN, RT_LOG, shift, decay);
-            Features.push_back(slice.Importance);
-            if (decay != 86400.) {
-                continue;
-            }
-            for (const std::string& code : codes) {
-                Features.push_back(slice.WeightedCountryShare[code]);
-            }
-        }
+    const float meanNorm = meanPoint.norm();
+    if (meanNorm > 0.0f) {
+        meanPoint /= meanNorm;
     }
-    for (ERatingType type : {RT_RAW, RT_ONE}) {
-        for (double decay : decays) {
-            auto slice = CalcImportance(alexaRating, docs, tg::LN_EN, type, 0.0, decay);
-            Features.push_back(slice.Importance);
-            if (decay != 86400.) {
+    Centroid.assign(meanPoint.data(), meanPoint.data() + meanPoint.size());
+}
+
+namespace {
+
+// Importance slices are all combinations of agency weights and time decays
+struct TSliceWeight {
+    ERatingType Type;
+    size_t ShiftIndex; // in RATING_SHIFTS
+};
+constexpr TSliceWeight SLICE_WEIGHTS[] = {{RT_LOG, 1}, {RT_LOG, 2}, {RT_LOG, 3}, {RT_RAW, 0}, {RT_ONE, 0}};
+constexpr double SLICE_DECAYS[] = {1800., 3600., 7200., 86400.};
+constexpr size_t WEIGHTS_COUNT = std::size(SLICE_WEIGHTS);
+constexpr size_t DECAYS_COUNT = std::size(SLICE_DECAYS);
+// Country shares are features only for the longest decay
+constexpr size_t COUNTRY_FEATURES_DECAY = DECAYS_COUNT - 1;
+
+// Main slice: RT_LOG, shift 1, decay 3600
+constexpr size_t MAIN_WEIGHT = 0;
+constexpr size_t MAIN_DECAY = 1;
+
+using TSliceWeights = std::array<double, WEIGHTS_COUNT>;
+
+template <size_t... K>
+TSliceWeights GetSliceWeights(const TAlexaAgencyRating& alexaRating, THostId host, std::index_sequence<K...>) {
+    return {alexaRating.GetScore<tg::LN_EN, SLICE_WEIGHTS[K].Type, SLICE_WEIGHTS[K].ShiftIndex>(host)...};
+}
+
+using TSliceImportance = std::array<std::array<double, DECAYS_COUNT>, WEIGHTS_COUNT>;
+using TSliceCountryShares = std::array<TCountryShares, WEIGHTS_COUNT>;
+
+std::vector<double> MakeFeatures(const TSliceImportance& importance, const TSliceCountryShares& weightedCountryShare) {
+    std::vector<double> features;
+    features.reserve(WEIGHTS_COUNT * (DECAYS_COUNT + CC_COUNT));
+    for (size_t k = 0; k < WEIGHTS_COUNT; ++k) {
+        for (size_t d = 0; d < DECAYS_COUNT; ++d) {
+            features.push_back(importance[k][d]);
+            if (d != COUNTRY_FEATURES_DECAY) {
                 continue;
             }
-            for (const std::string& code : codes) {
-                Features.push_back(slice.WeightedCountryShare[code]);
+            for (size_t c = 0; c < CC_COUNT; ++c) {
+                features.push_back(weightedCountryShare[k][c]);
             }
         }
     }
+    return features;
 }
 
-TSliceFeatures TNewsCluster::CalcImportance(
-    const TAlexaAgencyRating& alexaRating,
-    const std::vector<TDbDocument>& docs,
-    tg::ELanguage language,
-    ERatingType type,
-    double shift,
-    double decay)
-{
-    double count = 0;
-    double wCount = 0;
-    TSliceFeatures slice;
+}
 
-    const char* codes[] = {"US", "GB", "IN", "RU", "CA", "AU"};
-    for (const std::string& code : codes) {
-        slice.CountryShare[code] = 0;
-        slice.WeightedCountryShare[code] = 0;
+void TNewsCluster::CalcImportance(const TAlexaAgencyRating& alexaRating, bool withFeatures) {
+    if (GetSize() == 1) {
+        CalcSingletonImportance(alexaRating, withFeatures);
+        return;
     }
 
-    slice.DocWeights.reserve(GetSize());
+    // Ratings are looked up once per host, hosts get cluster-local ids
+    std::unordered_map<THostId, size_t> hostIds;
+    std::vector<TSliceWeights> hostWeights;
+    std::vector<TCountryShares> hostShares;
+    std::vector<size_t> docHostIds;
+    docHostIds.reserve(GetSize());
     for (const TDbDocument& doc : Documents) {
-        double agencyWeight = alexaRating.ScoreUrl(doc.Host, language, type, shift);
-        slice.DocWeights.push_back(agencyWeight);
-
-        const std::string& docHost = doc.Host;;
-        for (const std::string& code : codes) {
-            double share = alexaRating.GetCountryShare(docHost, code);
-            slice.CountryShare[code] += share;
-            slice.WeightedCountryShare[code] += share * agencyWeight;
+        const auto [it, isNew] = hostIds.try_emplace(doc.HostId, hostIds.size());
+        docHostIds.push_back(it->second);
+        if (!isNew) {
+            continue;
+        }
+        hostWeights.push_back(GetSliceWeights(alexaRating, doc.HostId, std::make_index_sequence<WEIGHTS_COUNT>()));
+        auto& shares = hostShares.emplace_back();
+        for (size_t c = 0; c < CC_COUNT; ++c) {
+            shares[c] = alexaRating.GetCountryShare(doc.HostId, static_cast<ECountry>(c));
         }
-        count += 1;
-        wCount += agencyWeight;
     }
 
-    for (const std::string& code : codes) {
+    double count = 0;
+    std::array<double, WEIGHTS_COUNT> wCount{};
+    TCountryShares countryShare{};
+    TSliceCountryShares weightedCountryShare{};
+    DocWeights.clear();
+    DocWeights.reserve(GetSize());
+    for (size_t i = 0; i < GetSize(); ++i) {
+        const auto& weights = hostWeights[docHostIds[i]];
+        const auto& shares = hostShares[docHostIds[i]];
+        DocWeights.push_back(weights[MAIN_WEIGHT]);
+        for (size_t c = 0; c < CC_COUNT; ++c) {
+            countryShare[c] += shares[c];
+            for (size_t k = 0; k < WEIGHTS_COUNT; ++k) {
+                weightedCountryShare[k][c] += shares[c] * weights[k];
+            }
+        }
+        count += 1;
+        for (size_t k = 0; k < WEIGHTS_COUNT; ++k) {
+            wCount[k] += weights[k];
+        }
+    }
+    for (size_t c = 0; c < CC_COUNT; ++c) {
         if (count > 0) {
-            slice.CountryShare[code] /= count;
+            countryShare[c] /= count;
         }
-        if (wCount > 0) {
-            slice.WeightedCountryShare[code] /= wCount;
+        for (size_t k = 0; k < WEIGHTS_COUNT; ++k) {
+            if (wCount[k] > 0) {
+                weightedCountryShare[k][c] /= wCount[k];
+            }
         }
     }
 
-    for (size_t i = 0; i < docs.size(); ++i) {
-        const TDbDocument& startDoc = docs[i];
+    std::vector<size_t> order(GetSize());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](size_t i1, size_t i2) {
+        const TDbDocument& p1 = Documents[i1].get();
+        const TDbDocument& p2 = Documents[i2].get();
+        if (p1.FetchTime != p2.FetchTime) {
+            return p1.FetchTime < p2.FetchTime;
+        }
+        return p1.Url < p2.Url;
+    });
+
+    // Rank of a start document sums time-decayed weights of the first documents of every host after it.
+    // All slices share the host walk and the sigmoids of a decay, sums keep the original order.
+    // Without features only the main slice is computed, the others stay zero
+    const size_t weightsBegin = withFeatures ? 0 : MAIN_WEIGHT;
+    const size_t weightsEnd = withFeatures ? WEIGHTS_COUNT : MAIN_WEIGHT + 1;
+    const size_t decaysBegin = withFeatures ? 0 : MAIN_DECAY;
+    const size_t decaysEnd = withFeatures ? DECAYS_COUNT : MAIN_DECAY + 1;
+    TSliceImportance importance{};
+    std::array<std::array<uint64_t, DECAYS_COUNT>, WEIGHTS_COUNT> bestTimestamp{};
+    std::vector<size_t> hostSeenAt(hostWeights.size(), GetSize());
+    for (size_t i = 0; i < GetSize(); ++i) {
+        const TDbDocument& startDoc = Documents[order[i]].get();
         int32_t startTime = startDoc.FetchTime;
-        double rank = 0.;
-
-        std::set<std::string> seenHosts;
-        for (size_t j = i; j < docs.size(); ++j) {
-            const TDbDocument& doc = docs[j];
-            const std::string& docHost = doc.Host;
-            if (seenHosts.insert(docHost).second) {
-                double agencyWeight = alexaRating.ScoreUrl(docHost, language, type, shift);
-                double docTimestampRemapped = static_cast<double>(startTime - static_cast<int32_t>(doc.FetchTime)) / decay;
-                double timeMultiplier = Sigmoid(std::max(docTimestampRemapped, -15.));
-                double score = agencyWeight * timeMultiplier;
-                rank += score;
+        std::array<std::array<double, DECAYS_COUNT>, WEIGHTS_COUNT> rank{};
+        for (size_t j = i; j < GetSize(); ++j) {
+            const size_t hostId = docHostIds[order[j]];
+            if (hostSeenAt[hostId] == i) {
+                continue;
+            }
+            hostSeenAt[hostId] = i;
+            const TDbDocument& doc = Documents[order[j]].get();
+            std::array<double, DECAYS_COUNT> timeMultipliers;
+            for (size_t d = decaysBegin; d < decaysEnd; ++d) {
+                double docTimestampRemapped = static_cast<double>(startTime - static_cast<int32_t>(doc.FetchTime)) / SLICE_DECAYS[d];
+                timeMultipliers[d] = Sigmoid(std::max(docTimestampRemapped, -15.));
+            }
+            const auto& weights = hostWeights[hostId];
+            for (size_t k = weightsBegin; k < weightsEnd; ++k) {
+                for (size_t d = decaysBegin; d < decaysEnd; ++d) {
+                    double score = weights[k] * timeMultipliers[d];
+                    rank[k][d] += score;
+                }
             }
         }
-        if (rank > slice.Importance) {
-            slice.Importance = rank;
-            slice.BestTimestamp = startDoc.FetchTime;
+        for (size_t k = weightsBegin; k < weightsEnd; ++k) {
+            for (size_t d = decaysBegin; d < decaysEnd; ++d) {
+                if (rank[k][d] > importance[k][d]) {
+                    importance[k][d] = rank[k][d];
+                    bestTimestamp[k][d] = startDoc.FetchTime;
+                }
+            }
         }
     }
-    return slice;
+
+    BestTimestamp = bestTimestamp[MAIN_WEIGHT][MAIN_DECAY];
+    Importance = importance[MAIN_WEIGHT][MAIN_DECAY];
+    CountryShare = countryShare;
+    WeightedCountryShare = weightedCountryShare[MAIN_WEIGHT];
+    Features.clear();
+    if (withFeatures) {
+        Features = MakeFeatures(importance, weightedCountryShare);
+    }
 }
 
-void TNewsCluster::CalcImportance(const TAlexaAgencyRating& alexaRating) {
-    auto docs = GetDocuments();
-    std::stable_sort(docs.begin(), docs.end(), [](const TDbDocument& p1, const TDbDocument& p2) {
-        if (p1.FetchTime != p2.FetchTime) {
-            return p1.FetchTime < p2.FetchTime;
+// Same results as the general case: one document, one host, zero time difference
+void TNewsCluster::CalcSingletonImportance(const TAlexaAgencyRating& alexaRating, bool withFeatures) {
+    const TDbDocument& doc = Documents.front().get();
+    const TSliceWeights weights = GetSliceWeights(alexaRating, doc.HostId, std::make_index_sequence<WEIGHTS_COUNT>());
+    TCountryShares shares;
+    for (size_t c = 0; c < CC_COUNT; ++c) {
+        shares[c] = alexaRating.GetCountryShare(doc.HostId, static_cast<ECountry>(c));
+    }
+    const double timeMultiplier = Sigmoid(0.);
+
+    TSliceImportance importance{};
+    TSliceCountryShares weightedCountryShare{};
+    for (size_t k = 0; k < WEIGHTS_COUNT; ++k) {
+        const double rank = weights[k] * timeMultiplier;
+        importance[k].fill(rank > 0 ? rank : 0.);
+        for (size_t c = 0; c < CC_COUNT; ++c) {
+            weightedCountryShare[k][c] = weights[k] > 0 ? shares[c] * weights[k] / weights[k] : shares[c] * weights[k];
         }
-        return p1.Url < p2.Url;
-    });
-    CalcFeatures(alexaRating, docs);
-    TSliceFeatures slice = CalcImportance(alexaRating, docs, tg::LN_EN, RT_LOG, 1., 3600);
-    BestTimestamp = slice.BestTimestamp;
-    Importance = slice.Importance;
-    DocWeights = slice.DocWeights;
-    CountryShare = slice.CountryShare;
-    WeightedCountryShare = slice.WeightedCountryShare;
+    }
+
+    DocWeights.assign(1, weights[MAIN_WEIGHT]);
+    Importance = importance[MAIN_WEIGHT][MAIN_DECAY];
+    BestTimestamp = Importance > 0 ? doc.FetchTime : 0;
+    CountryShare = shares;
+    WeightedCountryShare = weightedCountryShare[MAIN_WEIGHT];
+    Features.clear();
+    if (withFeatures) {
+        Features = MakeFeatures(importance, weightedCountryShare);
+    }
 }
 
 void TNewsCluster::CalcCategory() {
@@ -187,23 +308,19 @@ void TNewsCluster::CalcCategory() {
 }
 
 void TNewsCluster::SortByWeights(const std::vector<double>& weights) {
-    std::vector<std::pair<TDbDocument, double>> weightedDocs;
+    std::vector<std::pair<std::reference_wrapper<const TDbDocument>, double>> weightedDocs;
     weightedDocs.reserve(Documents.size());
     for (size_t i = 0; i < Documents.size(); i++) {
-        weightedDocs.emplace_back(std::move(Documents[i]), weights[i]);
+        weightedDocs.emplace_back(Documents[i], weights[i]);
     }
-    Documents.clear();
-    std::stable_sort(weightedDocs.begin(), weightedDocs.end(), [](
-        const std::pair<TDbDocument, double>& a,
-        const std::pair<TDbDocument, double>& b)
-    {
+    std::stable_sort(weightedDocs.begin(), weightedDocs.end(), [](const auto& a, const auto& b) {
         if (std::abs(a.second - b.second) < 0.000001) {
-            return a.first.Title < b.first.Title;
+            return a.first.get().Title < b.first.get().Title;
         }
         return a.second > b.second;
     });
-    for (const auto& [doc, _] : weightedDocs) {
-        AddDocument(doc);
+    for (size_t i = 0; i < Documents.size(); i++) {
+        Documents[i] = weightedDocs[i].first;
     }
 }
 
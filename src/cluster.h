@@ -1,20 +1,16 @@
 #pragma once
 
 #include "db_document.h"
+#include "document_store.h"
 #include "agency_rating.h"
+#include "index_snapshot.pb.h"
+
+#include <functional>
+#include <vector>
 
 class TAgencyRating;
 class TAlexaAgencyRating;
 
-struct TSliceFeatures {
-    uint64_t BestTimestamp = 0;
-    double Importance = 0.0;
-    std::vector<double> DocWeights;
-    std::map<std::string, double> CountryShare;
-    std::map<std::string, double> WeightedCountryShare;
-};
-
-
 class TNewsCluster {
 private:
     uint64_t Id = 0;
@@ -25,30 +21,29 @@ private:
     double Importance = 0.0;
     std::vector<double> Features;
     std::vector<double> DocWeights;
-    std::map<std::string, double> CountryShare;
-    std::map<std::string, double> WeightedCountryShare;
+    TCountryShares CountryShare{};
+    TCountryShares WeightedCountryShare{};
+    // Normalized mean of normalized document embeddings, set by Summarize
+    std::vector<float> Centroid;
 
-    std::vector<TDbDocument> Documents;
+    // Documents are owned by the document store of TClusterIndex
+    std::vector<std::reference_wrapper<const TDbDocument>> Documents;
 
 public:
     explicit TNewsCluster(uint64_t id) : Id(id) {};
 
-    void AddDocument(const TDbDocument& document);
-    void Summarize(const TAgencyRating& agencyRating);
+    // Ranked cluster of an index snapshot, documents are indices in the language documents
+    static TNewsCluster FromProto(const tg::TNewsClusterProto& proto, const std::vector<TDbDocument>& documents);
+    tg::TNewsClusterProto ToProto(const std::vector<TDbDocument>& documents) const;
 
-    void CalcFeatures(
-        const TAlexaAgencyRating& alexaRating,
-        const std::vector<TDbDocument>& docs);
-
-    TSliceFeatures CalcImportance(
-        const TAlexaAgencyRating& alexaRating,
-        const std::vector<TDbDocument>& docs,
-        tg::ELanguage language,
-        ERatingType type,
-        double shift,
-        double decay);
+    // The document must outlive the cluster
+    void AddDocument(const TDbDocument& document);
+    // Documents must belong to langDocs
+    void Summarize(const TAgencyRating& agencyRating, const TLanguageDocuments& langDocs);
 
-    void CalcImportance(const TAlexaAgencyRating& alexaRating);
+    // Computes importance of the main (rating type, shift, decay) slice,
+    // and of all the other slices as ranking features if withFeatures is set
+    void CalcImportance(const TAlexaAgencyRating& alexaRating, bool withFeatures);
     void CalcCategory();
 
     bool operator<(const TNewsCluster& other) const;
@@ -59,16 +54,18 @@ public:
     tg::ECategory GetCategory() const { return Category; }
     uint64_t GetFreshestTimestamp() const { return FreshestTimestamp; }
     size_t GetSize() const { return Documents.size(); }
-    const std::vector<TDbDocument>& GetDocuments() const { return Documents; }
-    std::string GetTitle() const { return Documents.front().Title; }
-    tg::ELanguage GetLanguage() const { return Documents.front().Language; }
+    const std::vector<std::reference_wrapper<const TDbDocument>>& GetDocuments() const { return Documents; }
+    const std::string& GetTitle() const { return Documents.front().get().Title; }
+    tg::ELanguage GetLanguage() const { return Documents.front().get().Language; }
     double GetImportance() const { return Importance; }
     uint64_t GetBestTimestamp() const { return BestTimestamp; }
     const std::vector<double>& GetDocWeights() const { return DocWeights; }
     const std::vector<double>& GetFeatures() const { return Features; }
-    const std::map<std::string, double>& GetCountryShare() const { return CountryShare; }
-    const std::map<std::string, double>& GetWeightedCountryShare() const { return WeightedCountryShare; }
+    const TCountryShares& GetCountryShare() const { return CountryShare; }
+    const TCountryShares& GetWeightedCountryShare() const { return WeightedCountryShare; }
+    const std::vector<float>& GetCentroid() const { return Centroid; }
 private:
+    void CalcSingletonImportance(const TAlexaAgencyRating& alexaRating, bool withFeatures);
     void SortByWeights(const std::vector<double>& weights);
 };
 
@@ -22,8 +22,11 @@ uint64_t GetIterTimestamp(const std::vector<TDbDocument>& documents, double perc
     return documents[index].FetchTime;
 }
 
-TClusterer::TClusterer(const std::string& configPath) {
+TClusterer::TClusterer(const std::string& configPath, bool computeFeatures) {
     ParseConfig(configPath);
+    if (computeFeatures) {
+        Config.set_compute_features(true);
+    }
     for (const tg::TClusteringConfig& config: Config.clusterings()) {
         Clusterings[config.language()] = std::make_unique<TSlinkClustering>(config);
     }
@@ -38,7 +41,7 @@ TClusterer::TClusterer(const std::string& configPath) {
     LOG_DEBUG("Alexa agency ratings loaded");
 }
 
-TClusterIndex TClusterer::Cluster(std::vector<TDbDocument>&& docs) const {
+TClusterIndex TClusterer::Cluster(std::vector<TDbDocument>&& docs, ETaskPriority priority) const {
     std::stable_sort(docs.begin(), docs.end(),
         [](const TDbDocument& d1, const TDbDocument& d2) {
             if (d1.FetchTime == d2.FetchTime) {
@@ -54,25 +57,35 @@ TClusterIndex TClusterer::Cluster(std::vector<TDbDocument>&& docs) const {
     clusterIndex.IterTimestamp = GetIterTimestamp(docs, Config.iter_timestamp_percentile());
     clusterIndex.TrueMaxTimestamp = docs.empty() ? 0 : docs.back().FetchTime;
 
-    std::map<tg::ELanguage, std::vector<TDbDocument>> lang2Docs;
+    auto lang2Docs = std::make_shared<TDocumentStore>();
+    for (const auto& [language, _] : Clusterings) {
+        (*lang2Docs)[language];
+    }
     while (!docs.empty()) {
-        const TDbDocument& doc = docs.back();
-        if (Clusterings.find(doc.Language) != Clusterings.end()) {
-            lang2Docs[doc.Language].push_back(doc);
+        TDbDocument& doc = docs.back();
+        const auto it = lang2Docs->find(doc.Language);
+        if (it != lang2Docs->end()) {
+            it->second.Documents.push_back(std::move(doc));
         }
         docs.pop_back();
     }
     docs.shrink_to_fit();
-    docs.clear();
+    for (auto& [language, langDocs] : *lang2Docs) {
+        langDocs.Embeddings = TEmbeddingMatrix(langDocs.Documents, tg::EK_FASTTEXT_CLASSIC);
+    }
+    clusterIndex.Documents = lang2Docs;
 
+    TThreadPool& threadPool = TThreadPool::Get();
     for (const auto& [language, clustering] : Clusterings) {
-        TClusters langClusters = clustering->Cluster(lang2Docs[language]);
-        for (TNewsCluster& cluster: langClusters) {
+        const TLanguageDocuments& langDocs = lang2Docs->at(language);
+        TClusters langClusters = clustering->Cluster(langDocs.Documents, langDocs.Embeddings);
+        threadPool.parallel_for(0, langClusters.size(), [&](size_t i) {
+            TNewsCluster& cluster = langClusters[i];
             assert(cluster.GetSize() > 0);
-            cluster.Summarize(AgencyRating);
-            cluster.CalcImportance(AlexaAgencyRating);
+            cluster.Summarize(AgencyRating, langDocs);
+            cluster.CalcImportance(AlexaAgencyRating, Config.compute_features());
             cluster.CalcCategory();
-        }
+        }, /* grainSize */ 0, priority);
         std::stable_sort(
             langClusters.begin(),
             langClusters.end(),
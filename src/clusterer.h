@@ -5,21 +5,32 @@
 #include "clustering/clustering.h"
 #include "config.pb.h"
 #include "db_document.h"
+#include "document_store.h"
+#include "rank.h"
+#include "thread_pool.h"
 
 #include <vector>
 #include <memory>
 
 struct TClusterIndex {
+    // Clusters reference documents of this store, it is never modified after clustering
+    std::shared_ptr<const TDocumentStore> Documents;
     std::unordered_map<tg::ELanguage, TClusters> Clusters;
+    // Rank output for standard periods, built at publish time, see BuildRankedViews
+    std::unordered_map<tg::ELanguage, std::vector<TRankedView>> RankedViews;
     uint64_t IterTimestamp = 0;
     uint64_t TrueMaxTimestamp = 0;
+    // Number of the published index, changes every time the index is replaced
+    uint64_t Generation = 0;
 };
 
 class TClusterer {
 public:
-    explicit TClusterer(const std::string& configPath);
+    // computeFeatures enables ranking features regardless of the config
+    explicit TClusterer(const std::string& configPath, bool computeFeatures = false);
 
-    TClusterIndex Cluster(std::vector<TDbDocument>&& docs) const;
+    // Clusters are summarized on the shared thread pool in the priority lane
+    TClusterIndex Cluster(std::vector<TDbDocument>&& docs, ETaskPriority priority = TP_BULK) const;
 
 private:
     void Summarize(TClusters& clusters) const;
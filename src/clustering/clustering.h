@@ -2,13 +2,15 @@
 
 #include "../cluster.h"
 #include "../db_document.h"
+#include "../document_store.h"
 
 class TClustering {
 public:
     TClustering() = default;
     virtual ~TClustering() = default;
+    // embeddings has a row for every document
     virtual TClusters Cluster(
         const std::vector<TDbDocument>& docs,
-        tg::EEmbeddingKey embeddingKey = tg::EK_FASTTEXT_CLASSIC
+        const TEmbeddingMatrix& embeddings
     ) = 0;
 };
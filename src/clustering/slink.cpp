@@ -71,8 +71,9 @@ TSlinkClustering::TSlinkClustering(const tg::TClusteringConfig& config)
 
 TClusters TSlinkClustering::Cluster(
     const std::vector<TDbDocument>& docs,
-    tg::EEmbeddingKey embeddingKey
+    const TEmbeddingMatrix& embeddings
 ) {
+    assert(embeddings.GetRowCount() == docs.size());
     const size_t docSize = docs.size();
     std::vector<size_t> labels;
     labels.reserve(docSize);
@@ -87,7 +88,7 @@ TClusters TSlinkClustering::Cluster(
         size_t batchSize = std::min(remainingDocsCount, static_cast<size_t>(Config.chunk_size()));
         std::vector<TDbDocument>::const_iterator end = begin + batchSize;
 
-        std::vector<size_t> newLabels = ClusterBatch(begin, end, embeddingKey);
+        std::vector<size_t> newLabels = ClusterBatch(begin, end, embeddings.GetRows(batchStart, batchSize));
         size_t newMaxLabel = maxLabel;
         for (auto& label : newLabels) {
             label += maxLabel;
@@ -151,20 +152,11 @@ TClusters TSlinkClustering::Cluster(
 std::vector<size_t> TSlinkClustering::ClusterBatch(
     const std::vector<TDbDocument>::const_iterator begin,
     const std::vector<TDbDocument>::const_iterator end,
-    tg::EEmbeddingKey embeddingKey
+    const TEmbeddingMatrix::TRowsMap& points
 ) {
     const size_t docSize = std::distance(begin, end);
     assert(docSize != 0);
-    const size_t embSize = begin->Embeddings.at(embeddingKey).size();
-
-    Eigen::MatrixXf points(docSize, embSize);
-    std::vector<TDbDocument>::const_iterator docsIt = begin;
-    for (size_t i = 0; i < docSize; ++i) {
-        std::vector<float> embedding = docsIt->Embeddings.at(embeddingKey);
-        Eigen::Map<Eigen::VectorXf, Eigen::Unaligned> eigenVector(embedding.data(), embedding.size());
-        points.row(i) = eigenVector / eigenVector.norm();
-        docsIt++;
-    }
+    assert(static_cast<size_t>(points.rows()) == docSize);
 
     Eigen::MatrixXf distances(points.rows(), points.rows());
     FillDistanceMatrix(points, distances);
@@ -262,7 +254,7 @@ std::vector<size_t> TSlinkClustering::ClusterBatch(
     return labels;
 }
 
-void TSlinkClustering::FillDistanceMatrix(const Eigen::MatrixXf& points, Eigen::MatrixXf& distances) const {
+void TSlinkClustering::FillDistanceMatrix(const TEmbeddingMatrix::TRowsMap& points, Eigen::MatrixXf& distances) const {
     // Assuming points are on unit sphere
     // Normalize to [0.0, 1.0]
     distances = -((points * points.transpose()).array() + 1.0f) / 2.0f + 1.0f;
@@ -11,18 +11,18 @@ public:
 
     TClusters Cluster(
         const std::vector<TDbDocument>& docs,
-        tg::EEmbeddingKey embeddingKey = tg::EK_FASTTEXT_CLASSIC
+        const TEmbeddingMatrix& embeddings
     ) override;
 
 private:
     void FillDistanceMatrix(
-        const Eigen::MatrixXf& points,
+        const TEmbeddingMatrix::TRowsMap& points,
         Eigen::MatrixXf& distances
     ) const;
     std::vector<size_t> ClusterBatch(
         const std::vector<TDbDocument>::const_iterator begin,
         const std::vector<TDbDocument>::const_iterator end,
-        tg::EEmbeddingKey embeddingKey = tg::EK_FASTTEXT_CLASSIC
+        const TEmbeddingMatrix::TRowsMap& points
     );
 
 private:
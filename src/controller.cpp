@@ -3,21 +3,28 @@
 #include "document.h"
 #include "document.pb.h"
 #include "rank.h"
+#include "thread_pool.h"
 #include "util.h"
 
+#include <chrono>
 #include <optional>
 #include <tinyxml2/tinyxml2.h>
 
 void TController::Init(
     const THotState<TClusterIndex>* index,
     rocksdb::DB* db,
+    const TDocumentTimeIndex* timeIndex,
     std::unique_ptr<TAnnotator> annotator,
-    bool skipIrrelevantDocs
+    bool skipIrrelevantDocs,
+    bool gzipThreads
 ) {
     Index = index;
     Db = db;
+    TimeIndex = timeIndex;
     Annotator = std::move(annotator);
     SkipIrrelevantDocs = skipIrrelevantDocs;
+    GzipThreads = gzipThreads;
+    StartTime = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
     Initialized.store(true, std::memory_order_release);
 }
 
@@ -62,6 +69,25 @@ void TController::Put(const drogon::HttpRequestPtr &req, std::function<void(cons
         return;
     }
 
+    // Annotation runs in the interactive lane of the shared pool, not on the event loop thread
+    TThreadPool::Get().enqueue(TP_INTERACTIVE, [this, req, callback=std::move(callback), fname, ttl=ttl.value()]() mutable {
+        // Store may throw after it has replied, the request must get exactly one response
+        bool responded = false;
+        try {
+            Store(req, [&responded, &callback](const drogon::HttpResponsePtr& response) {
+                responded = true;
+                callback(response);
+            }, fname, ttl);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Failed to store " << fname << ": " << e.what());
+            if (!responded) {
+                MakeSimpleResponse(std::move(callback), drogon::k500InternalServerError);
+            }
+        }
+    });
+}
+
+void TController::Store(const drogon::HttpRequestPtr& req, std::function<void(const drogon::HttpResponsePtr&)>&& callback, const std::string& fname, uint64_t ttl) const {
     tinyxml2::XMLDocument html;
     const tinyxml2::XMLError parseCode = html.Parse(req->bodyData(), req->bodyLength());
     if (parseCode != tinyxml2::XML_SUCCESS) {
@@ -85,7 +111,7 @@ void TController::Put(const drogon::HttpRequestPtr &req, std::function<void(cons
 
     std::string serializedDoc;
     if (dbDoc) {
-        dbDoc->Ttl = ttl.value();
+        dbDoc->Ttl = ttl;
         const bool success = dbDoc->ToProtoString(&serializedDoc);
         if (!success) {
             MakeSimpleResponse(std::move(callback), drogon::k500InternalServerError);
@@ -96,7 +122,12 @@ void TController::Put(const drogon::HttpRequestPtr &req, std::function<void(cons
     // TODO: possible races while the same fname is provided to multiple queries
     // TODO: use "value_found" flag and check DB instead of only bloom filter
     const drogon::HttpStatusCode code = getCode();
-    const rocksdb::Status s = Db->Put(rocksdb::WriteOptions(), fname, serializedDoc);
+    rocksdb::WriteBatch batch;
+    batch.Put(fname, serializedDoc);
+    if (dbDoc) {
+        TimeIndex->Add(&batch, fname, dbDoc.value());
+    }
+    const rocksdb::Status s = Db->Write(rocksdb::WriteOptions(), &batch);
     if (!s.ok()) {
         MakeSimpleResponse(std::move(callback), drogon::k500InternalServerError);
         return;
@@ -133,29 +164,53 @@ namespace {
         return std::nullopt;
     }
 
+    // Unlike FromString, does not allocate
+    template <class TEnum, int Size>
+    TEnum ParseEnum(const std::string& value) {
+        static const std::vector<std::pair<std::string, TEnum>> names = [] {
+            std::vector<std::pair<std::string, TEnum>> names;
+            for (int i = 0; i < Size; ++i) {
+                const TEnum e = static_cast<TEnum>(i);
+                const nlohmann::json name(e);
+                if (name.is_string()) {
+                    names.emplace_back(name.get<std::string>(), e);
+                }
+            }
+            return names;
+        }();
+        for (const auto& [name, e] : names) {
+            if (name == value) {
+                return e;
+            }
+        }
+        return static_cast<TEnum>(0);
+    }
+
     std::optional<tg::ELanguage> ParseLang(const std::string& value) {
-        const tg::ELanguage lang = FromString<tg::ELanguage>(value);
+        const tg::ELanguage lang = ParseEnum<tg::ELanguage, tg::ELanguage_ARRAYSIZE>(value);
         return lang != tg::LN_UNDEFINED ? std::make_optional(lang) : std::nullopt;
     }
 
     std::optional<tg::ECategory> ParseCategory(const std::string& value) {
-        const tg::ECategory category = FromString<tg::ECategory>(value);
+        const tg::ECategory category = ParseEnum<tg::ECategory, tg::ECategory_ARRAYSIZE>(value);
         return category != tg::NC_UNDEFINED ? std::make_optional(category) : std::nullopt;
     }
 
-    Json::Value ToJson(const TNewsCluster& cluster) {
-        Json::Value articles(Json::arrayValue);
-        for (const auto& document : cluster.GetDocuments()) {
-            articles.append(document.FileName);
-        }
+}
 
-        Json::Value json(Json::objectValue);
-        json["title"] = cluster.GetTitle();
-        json["category"] = ToString(cluster.GetCategory());
-        json["articles"] = std::move(articles);
-        return json;
+std::shared_ptr<TThreadsResponseCache> TController::GetResponseCache(const TClusterIndex& index) const {
+    std::shared_ptr<TThreadsResponseCache> cache = ResponseCache.AtomicGet();
+    if (cache && cache->GetGeneration() == index.Generation) {
+        return cache;
     }
-
+    // Server start time keeps ETags unique across restarts
+    const std::string tag = std::to_string(StartTime) + "-" + std::to_string(index.Generation);
+    auto newCache = std::make_shared<TThreadsResponseCache>(index.Generation, tag);
+    // A request that still holds an older index must not replace the cache of a newer one
+    if (!cache || cache->GetGeneration() < index.Generation) {
+        ResponseCache.AtomicSet(newCache);
+    }
+    return newCache;
 }
 
 void TController::Threads(const drogon::HttpRequestPtr &req, std::function<void(const drogon::HttpResponsePtr&)> &&callback) const {
@@ -173,29 +228,33 @@ void TController::Threads(const drogon::HttpRequestPtr &req, std::function<void(
     }
 
     const std::shared_ptr<TClusterIndex> index = Index->AtomicGet();
+    const std::shared_ptr<TThreadsResponseCache> responseCache = GetResponseCache(*index);
+    const bool gzip = GzipThreads && req->getHeader("Accept-Encoding").find("gzip") != std::string::npos;
+    if (responseCache->IsNotModified(req->getHeader("If-None-Match"))) {
+        callback(responseCache->GetNotModified(gzip));
+        return;
+    }
 
-    const auto& clusters = index->Clusters.at(lang.value()); // TODO: possible missing key
-    const uint64_t fromTimestamp = index->TrueMaxTimestamp > period.value() ? index->TrueMaxTimestamp - period.value() : 0;
-
-    const auto indexIt = std::lower_bound(clusters.cbegin(), clusters.cend(), fromTimestamp, TNewsCluster::Compare);
-    const auto weightedClusters = Rank(indexIt, clusters.cend(), index->IterTimestamp, period.value());
-    const auto& categoryClusters = weightedClusters.at(category.value());
-
-    Json::Value threads(Json::arrayValue);
-    int limit = 1000;
-    for (const auto& weightedCluster : categoryClusters) {
-        if (limit <= 0) {
-            break;
+    // Standard periods are ranked at publish time, their responses are serialized once per index
+    const auto viewsIt = index->RankedViews.find(lang.value());
+    if (viewsIt != index->RankedViews.end()) {
+        for (const TRankedView& view : viewsIt->second) {
+            if (view.Period != period.value()) {
+                continue;
+            }
+            const auto& categoryClusters = view.Categories.at(category.value());
+            callback(responseCache->Get(lang.value(), category.value(), period.value(), gzip, [&categoryClusters] {
+                return MakeThreadsJson(categoryClusters);
+            }));
+            return;
         }
-        const TNewsCluster& cluster = weightedCluster.Cluster.get();
-        threads.append(ToJson(cluster));
-        --limit;
     }
 
-    Json::Value json(Json::objectValue);
-    json["threads"] = std::move(threads);
-    auto resp = drogon::HttpResponse::newHttpJsonResponse(json);
-    callback(resp);
+    const auto& clusters = index->Clusters.at(lang.value()); // TODO: possible missing key
+    const uint64_t fromTimestamp = index->TrueMaxTimestamp > period.value() ? index->TrueMaxTimestamp - period.value() : 0;
+    const auto indexIt = std::lower_bound(clusters.cbegin(), clusters.cend(), fromTimestamp, TNewsCluster::Compare);
+    const auto topClusters = RankTop(indexIt, clusters.cend(), index->IterTimestamp, period.value(), category.value(), MAX_THREADS_COUNT);
+    callback(responseCache->MakeResponse(MakeThreadsJson(topClusters), gzip));
 }
 
 void TController::Get(const drogon::HttpRequestPtr &req, std::function<void(const drogon::HttpResponsePtr&)> &&callback, const std::string& fname) const {
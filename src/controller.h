@@ -3,6 +3,8 @@
 #include "annotator.h"
 #include "clusterer.h"
 #include "hot_state.h"
+#include "threads_response.h"
+#include "time_index.h"
 
 #include <drogon/HttpController.h>
 #include <rocksdb/db.h>
@@ -19,8 +21,10 @@ public:
     void Init(
         const THotState<TClusterIndex>* index,
         rocksdb::DB* db,
+        const TDocumentTimeIndex* timeIndex,
         std::unique_ptr<TAnnotator> annotator,
-        bool skipIrrelevantDocs = false
+        bool skipIrrelevantDocs = false,
+        bool gzipThreads = false
     );
 
     void Put(const drogon::HttpRequestPtr &req, std::function<void(const drogon::HttpResponsePtr&)> &&callback, const std::string& fname) const;
@@ -30,6 +34,9 @@ public:
 
 private:
     bool IsNotReady(std::function<void(const drogon::HttpResponsePtr&)> &&callback) const;
+    // Annotates and saves the document of a PUT request, runs on the shared thread pool
+    void Store(const drogon::HttpRequestPtr& req, std::function<void(const drogon::HttpResponsePtr&)>&& callback, const std::string& fname, uint64_t ttl) const;
+    std::shared_ptr<TThreadsResponseCache> GetResponseCache(const TClusterIndex& index) const;
 
 private:
     std::atomic<bool> Initialized {false};
@@ -37,6 +44,11 @@ private:
     const THotState<TClusterIndex>* Index;
 
     rocksdb::DB* Db;
+    const TDocumentTimeIndex* TimeIndex;
     std::unique_ptr<TAnnotator> Annotator;
     bool SkipIrrelevantDocs = false;
+
+    bool GzipThreads = false;
+    uint64_t StartTime = 0;
+    mutable THotState<TThreadsResponseCache> ResponseCache;
 };
@@ -0,0 +1,122 @@
+#include "corpus.h"
+
+#include "thread_pool.h"
+#include "util.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+    constexpr char CORPUS_MAGIC[8] = {'T', 'G', 'C', 'O', 'R', 'P', 'U', 'S'};
+    constexpr uint32_t CORPUS_VERSION = 1;
+
+    struct TCorpusHeader {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t Reserved;
+        uint64_t AnnotatorFingerprint;
+        uint64_t Count;
+    };
+
+    // Read-only mapping of a whole file
+    class TMappedFile {
+    public:
+        explicit TMappedFile(const std::string& path) {
+            const int fileDesc = open(path.c_str(), O_RDONLY);
+            ENSURE(fileDesc >= 0, "Could not open corpus " << path);
+            struct stat fileStat;
+            const bool hasStat = fstat(fileDesc, &fileStat) == 0;
+            Size = hasStat ? fileStat.st_size : 0;
+            void* data = Size != 0 ? mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, fileDesc, 0) : MAP_FAILED;
+            close(fileDesc);
+            ENSURE(data != MAP_FAILED, "Could not map corpus " << path);
+            Data = static_cast<const char*>(data);
+        }
+
+        ~TMappedFile() {
+            munmap(const_cast<char*>(Data), Size);
+        }
+
+        const char* Data = nullptr;
+        size_t Size = 0;
+    };
+
+}
+
+TCorpusWriter::TCorpusWriter(const std::string& path, uint64_t annotatorFingerprint)
+    : Output(path, std::ios::binary | std::ios::trunc)
+    , Fingerprint(annotatorFingerprint)
+{
+    ENSURE(Output, "Could not open corpus " << path);
+    // Magic and count are written by Finish, an unfinished corpus is rejected
+    const TCorpusHeader header{{}, CORPUS_VERSION, 0, Fingerprint, 0};
+    Output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void TCorpusWriter::Add(const TDbDocument& document) {
+    Buffer.clear();
+    const bool success = document.ToProto().SerializeToString(&Buffer);
+    ENSURE(success, "Could not serialize " << document.FileName);
+    const uint32_t size = Buffer.size();
+    Output.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    Output.write(Buffer.data(), Buffer.size());
+    ++Count;
+}
+
+void TCorpusWriter::Finish() {
+    TCorpusHeader header{{}, CORPUS_VERSION, 0, Fingerprint, Count};
+    std::memcpy(header.Magic, CORPUS_MAGIC, sizeof(CORPUS_MAGIC));
+    Output.seekp(0);
+    Output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    Output.flush();
+    ENSURE(Output, "Could not write corpus");
+}
+
+bool IsCorpusFile(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    char magic[sizeof(CORPUS_MAGIC)];
+    return input.read(magic, sizeof(magic)) && std::memcmp(magic, CORPUS_MAGIC, sizeof(magic)) == 0;
+}
+
+TCorpus ReadCorpus(const std::string& path) {
+    const TMappedFile file(path);
+    ENSURE(file.Size >= sizeof(TCorpusHeader), "Bad corpus " << path);
+    TCorpusHeader header;
+    std::memcpy(&header, file.Data, sizeof(header));
+    ENSURE(std::memcmp(header.Magic, CORPUS_MAGIC, sizeof(CORPUS_MAGIC)) == 0, "Bad corpus " << path);
+    ENSURE(header.Version == CORPUS_VERSION, "Unsupported corpus version " << header.Version);
+
+    // Record boundaries are found sequentially, records are decoded in parallel
+    std::vector<std::pair<size_t, uint32_t>> records;
+    records.reserve(header.Count);
+    size_t offset = sizeof(TCorpusHeader);
+    while (offset < file.Size) {
+        uint32_t size = 0;
+        ENSURE(offset + sizeof(size) <= file.Size, "Truncated corpus " << path);
+        std::memcpy(&size, file.Data + offset, sizeof(size));
+        offset += sizeof(size);
+        ENSURE(offset + size <= file.Size, "Truncated corpus " << path);
+        records.emplace_back(offset, size);
+        offset += size;
+    }
+    ENSURE(records.size() == header.Count, "Corpus " << path << " has " << records.size() << " records, expected " << header.Count);
+
+    TCorpus corpus;
+    corpus.AnnotatorFingerprint = header.AnnotatorFingerprint;
+    corpus.Documents.resize(records.size());
+    std::atomic<size_t> badCount = 0;
+    TThreadPool::Get().parallel_for(0, records.size(), [&](size_t i) {
+        const auto [recordOffset, recordSize] = records[i];
+        if (!TDbDocument::ParseFromArray(file.Data + recordOffset, recordSize, &corpus.Documents[i])) {
+            ++badCount;
+        }
+    });
+    ENSURE(badCount == 0, "Corpus " << path << " has " << badCount << " bad records");
+    return corpus;
+}
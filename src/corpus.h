@@ -0,0 +1,36 @@
+#pragma once
+
+#include "db_document.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary corpus of annotated documents: a header with the annotator fingerprint,
+// then size-prefixed TDocumentProto records. Read through a memory mapping.
+class TCorpusWriter {
+public:
+    TCorpusWriter(const std::string& path, uint64_t annotatorFingerprint);
+
+    void Add(const TDbDocument& document);
+    // Writes the document count to the header, the corpus is invalid without it
+    void Finish();
+
+    size_t GetCount() const { return Count; }
+
+private:
+    std::ofstream Output;
+    uint64_t Fingerprint = 0;
+    uint64_t Count = 0;
+    std::string Buffer;
+};
+
+struct TCorpus {
+    uint64_t AnnotatorFingerprint = 0;
+    std::vector<TDbDocument> Documents;
+};
+
+bool IsCorpusFile(const std::string& path);
+// Records are decoded in parallel, in file order
+TCorpus ReadCorpus(const std::string& path);
@@ -6,13 +6,14 @@ TDbDocument TDbDocument::FromProto(const tg::TDocumentProto& proto) {
     document.FileName = proto.file_name();
     document.Url = proto.url();
     document.Host = GetHost(document.Url);
+    document.HostId = THostDictionary::Get().Intern(document.Host);
     document.SiteName = proto.site_name();
     document.PubTime = proto.pub_time();
-    document.FetchTime = proto.pub_time();
+    document.FetchTime = proto.fetch_time();
     document.Ttl = proto.ttl();
     document.Title = proto.title();
     document.Text = proto.text();
-    document.Description = proto.text();
+    document.Description = proto.description();
     document.Language = proto.language();
     document.Category = proto.category();
     document.Nasty = proto.nasty();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "document.pb.h"
+#include "host_dictionary.h"
 
 #include <nlohmann_json/json.hpp>
 
@@ -14,6 +15,8 @@ public:
     std::string Url;
     std::string SiteName;
     std::string Host;
+    // Id of Host in THostDictionary
+    THostId HostId = 0;
 
     uint64_t PubTime = 0;
     uint64_t FetchTime = 0;
@@ -23,8 +26,8 @@ public:
     std::string Text;
     std::string Description;
 
-    tg::ELanguage Language;
-    tg::ECategory Category;
+    tg::ELanguage Language = tg::LN_UNDEFINED;
+    tg::ECategory Category = tg::NC_UNDEFINED;
 
     using TEmbedding = std::vector<float>;
     std::unordered_map<tg::EEmbeddingKey, TEmbedding> Embeddings;
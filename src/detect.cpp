@@ -1,30 +1,21 @@
 #include "detect.h"
 #include "document.h"
 #include "util.h"
+#include "classifiers/ft_classifier.h"
 
-#include <algorithm>
 #include <optional>
-#include <sstream>
-
-#include <fasttext.h>
+#include <string_view>
 
 std::optional<std::pair<std::string, double>> RunFasttextClf(
-    const fasttext::FastText& model,
-    const std::string& originalText,
+    const TFastTextClassifier& model,
+    TTokenSpan tokens,
     double border)
 {
-    std::string text = originalText;
-    std::replace(text.begin(), text.end(), '\n', ' ');
-    std::istringstream ifs(text);
-    std::vector<std::pair<fasttext::real, std::string>> predictions;
-    model.predictLine(ifs, predictions, 1, border);
-    if (predictions.empty()) {
+    std::optional<TFastTextPrediction> prediction = model.Predict(tokens, border);
+    if (!prediction) {
         return std::nullopt;
     }
-    double probability = predictions[0].first;
-    const size_t FT_PREFIX_LENGTH = 9; // __label__
-    const std::string label = predictions[0].second.substr(FT_PREFIX_LENGTH);
-    return std::make_pair(label, probability);
+    return std::make_pair(model.GetLabel(prediction->LabelId), static_cast<double>(prediction->Probability));
 }
 
 bool TooManyUnknownSymbols(const TDocument& doc) {
@@ -66,8 +57,11 @@ bool TooManyUnknownSymbols(const TDocument& doc) {
     return false;
 }
 
-tg::ELanguage DetectLanguage(const fasttext::FastText& model, const TDocument& document) {
-    std::string sample(document.Title + " " + document.Description + " " + document.Text.substr(0, 100));
+tg::ELanguage DetectLanguage(const TFastTextClassifier& model, const TDocument& document) {
+    std::vector<std::string_view> sample;
+    TFastTextClassifier::Tokenize(document.Title, sample);
+    TFastTextClassifier::Tokenize(document.Description, sample);
+    TFastTextClassifier::Tokenize(std::string_view(document.Text).substr(0, LANGUAGE_DETECTION_TEXT_PREFIX), sample);
     auto pair = RunFasttextClf(model, sample, 0.4);
     if (!pair) {
         return tg::LN_UNDEFINED;
@@ -87,8 +81,7 @@ tg::ELanguage DetectLanguage(const fasttext::FastText& model, const TDocument& d
     return tg::LN_OTHER;
 }
 
-tg::ECategory DetectCategory(const fasttext::FastText& model, const std::string& title, const std::string& text) {
-    std::string sample(title + " " + text);
-    auto pair = RunFasttextClf(model, sample, 0.0);
+tg::ECategory DetectCategory(const TFastTextClassifier& model, TTokenSpan tokens) {
+    auto pair = RunFasttextClf(model, tokens, 0.0);
     return pair ? FromString<tg::ECategory>(pair->first) : tg::NC_UNDEFINED;
 }
@@ -1,12 +1,14 @@
 #pragma once
 
 #include "db_document.h"
+#include "token_span.h"
 
-namespace fasttext {
-    class FastText;
-}
+class TFastTextClassifier;
 
 struct TDocument;
 
-tg::ELanguage DetectLanguage(const fasttext::FastText& model, const TDocument& document);
-tg::ECategory DetectCategory(const fasttext::FastText& model, const std::string& title, const std::string& text);
+// DetectLanguage reads only this many first bytes of the document text
+constexpr size_t LANGUAGE_DETECTION_TEXT_PREFIX = 100;
+
+tg::ELanguage DetectLanguage(const TFastTextClassifier& model, const TDocument& document);
+tg::ECategory DetectCategory(const TFastTextClassifier& model, TTokenSpan tokens);
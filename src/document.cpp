@@ -2,7 +2,6 @@
 #include "util.h"
 
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/filesystem.hpp>
 #include <tinyxml2/tinyxml2.h>
 
 #include <sstream>
@@ -101,11 +100,10 @@ void TDocument::FromHtml(
     bool shrinkText,
     size_t maxWords)
 {
-    if (!boost::filesystem::exists(fileName)) {
+    tinyxml2::XMLDocument originalDoc;
+    if (originalDoc.LoadFile(fileName) == tinyxml2::XML_ERROR_FILE_NOT_FOUND) {
         throw std::runtime_error("No HTML file");
     }
-    tinyxml2::XMLDocument originalDoc;
-    originalDoc.LoadFile(fileName);
 
     FromHtml(originalDoc, fileName, parseLinks, shrinkText, maxWords);
 }
@@ -117,13 +115,38 @@ void TDocument::FromHtml(
     bool shrinkText,
     size_t maxWords)
 {
-    FileName = fileName;
+    FromHtmlHead(originalDoc, fileName);
+    FromHtmlBody(originalDoc, parseLinks, shrinkText, maxWords);
+}
+
+namespace {
 
+const tinyxml2::XMLElement* GetHtmlElement(const tinyxml2::XMLDocument& originalDoc) {
     const tinyxml2::XMLElement* htmlElement = originalDoc.FirstChildElement("html");
     if (!htmlElement) {
         throw std::runtime_error("Parser error: no html tag");
     }
-    const tinyxml2::XMLElement* headElement = htmlElement->FirstChildElement("head");
+    return htmlElement;
+}
+
+const tinyxml2::XMLElement* GetArticleElement(const tinyxml2::XMLDocument& originalDoc) {
+    const tinyxml2::XMLElement* bodyElement = GetHtmlElement(originalDoc)->FirstChildElement("body");
+    if (!bodyElement) {
+        throw std::runtime_error("Parser error: no body");
+    }
+    const tinyxml2::XMLElement* articleElement = bodyElement->FirstChildElement("article");
+    if (!articleElement) {
+        throw std::runtime_error("Parser error: no article");
+    }
+    return articleElement;
+}
+
+}
+
+void TDocument::FromHtmlHead(const tinyxml2::XMLDocument& originalDoc, const std::string& fileName) {
+    FileName = fileName;
+
+    const tinyxml2::XMLElement* headElement = GetHtmlElement(originalDoc)->FirstChildElement("head");
     if (!headElement) {
         throw std::runtime_error("Parser error: no head");
     }
@@ -155,14 +178,25 @@ void TDocument::FromHtml(
         }
         metaElement = metaElement->NextSiblingElement("meta");
     }
-    const tinyxml2::XMLElement* bodyElement = htmlElement->FirstChildElement("body");
-    if (!bodyElement) {
-        throw std::runtime_error("Parser error: no body");
-    }
-    const tinyxml2::XMLElement* articleElement = bodyElement->FirstChildElement("article");
-    if (!articleElement) {
-        throw std::runtime_error("Parser error: no article");
+}
+
+void TDocument::FromHtmlTextPrefix(const tinyxml2::XMLDocument& originalDoc, size_t minLength) {
+    Text.clear();
+    const tinyxml2::XMLElement* pElement = GetArticleElement(originalDoc)->FirstChildElement("p");
+    while (pElement && Text.length() < minLength) {
+        Text += GetFullText(pElement) + "\n";
+        pElement = pElement->NextSiblingElement("p");
     }
+}
+
+void TDocument::FromHtmlBody(
+    const tinyxml2::XMLDocument& originalDoc,
+    bool parseLinks,
+    bool shrinkText,
+    size_t maxWords)
+{
+    Text.clear();
+    const tinyxml2::XMLElement* articleElement = GetArticleElement(originalDoc);
     const tinyxml2::XMLElement* pElement = articleElement->FirstChildElement("p");
     {
         std::vector<std::string> links;
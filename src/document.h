@@ -48,4 +48,15 @@ public:
         bool shrinkText=false,
         size_t maxWords=200
     );
+
+    // Staged parsing: FromHtml is FromHtmlHead followed by FromHtmlBody
+    void FromHtmlHead(const tinyxml2::XMLDocument& html, const std::string& fileName);
+    void FromHtmlBody(
+        const tinyxml2::XMLDocument& html,
+        bool parseLinks=false,
+        bool shrinkText=false,
+        size_t maxWords=200
+    );
+    // Fills Text with whole paragraphs until it has at least minLength bytes, without links and address
+    void FromHtmlTextPrefix(const tinyxml2::XMLDocument& html, size_t minLength);
 };
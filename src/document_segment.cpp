@@ -0,0 +1,296 @@
+#include "document_segment.h"
+
+#include "util.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+struct TDocumentSegment::THeader {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t EmbeddingSize;
+    uint64_t Count;
+    uint64_t HeapSize;
+};
+
+struct TDocumentSegment::TStringRef {
+    uint64_t Offset;
+    uint64_t Size;
+};
+
+namespace {
+
+    constexpr char SEGMENT_MAGIC[8] = {'T', 'G', 'D', 'O', 'C', 'S', 'E', 'G'};
+    constexpr uint32_t SEGMENT_VERSION = 2;
+
+    enum EStringField {
+        SF_KEY = 0,
+        SF_FILE_NAME,
+        SF_URL,
+        SF_HOST,
+        SF_SITE_NAME,
+        SF_TITLE,
+        SF_COUNT
+    };
+
+    constexpr size_t Align(size_t offset) {
+        return (offset + 7) & ~static_cast<size_t>(7);
+    }
+
+    // Byte offsets of the columns, every column starts at a multiple of 8
+    struct TLayout {
+        size_t ValueHashes = 0;
+        size_t FetchTimes = 0;
+        size_t PubTimes = 0;
+        size_t Ttls = 0;
+        size_t Strings = 0;
+        size_t Languages = 0;
+        size_t Categories = 0;
+        size_t Nasty = 0;
+        size_t Embeddings = 0;
+        size_t Heap = 0;
+    };
+
+    TLayout GetLayout(size_t count, size_t embeddingSize) {
+        TLayout layout;
+        layout.ValueHashes = Align(sizeof(TDocumentSegment::THeader));
+        layout.FetchTimes = layout.ValueHashes + count * sizeof(uint64_t);
+        layout.PubTimes = layout.FetchTimes + count * sizeof(uint64_t);
+        layout.Ttls = layout.PubTimes + count * sizeof(uint64_t);
+        layout.Strings = layout.Ttls + count * sizeof(uint64_t);
+        layout.Languages = layout.Strings + count * SF_COUNT * sizeof(TDocumentSegment::TStringRef);
+        layout.Categories = Align(layout.Languages + count);
+        layout.Nasty = Align(layout.Categories + count);
+        layout.Embeddings = Align(layout.Nasty + count);
+        layout.Heap = layout.Embeddings + count * embeddingSize * sizeof(float);
+        return layout;
+    }
+
+    const TDbDocument::TEmbedding* GetClusteringEmbedding(const TDbDocument& document) {
+        const auto it = document.Embeddings.find(tg::EK_FASTTEXT_CLASSIC);
+        return it != document.Embeddings.end() ? &it->second : nullptr;
+    }
+
+}
+
+std::unique_ptr<TDocumentSegment> TDocumentSegment::Open(const std::string& path) {
+    const int fileDesc = open(path.c_str(), O_RDONLY);
+    if (fileDesc < 0) {
+        return nullptr;
+    }
+    struct stat fileStat;
+    if (fstat(fileDesc, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(THeader)) {
+        close(fileDesc);
+        LOG_ERROR("Invalid document segment " << path);
+        return nullptr;
+    }
+    const size_t size = fileStat.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fileDesc, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fileDesc);
+    if (data == MAP_FAILED) {
+        LOG_ERROR("Failed to map document segment " << path);
+        return nullptr;
+    }
+
+    std::unique_ptr<TDocumentSegment> segment(new TDocumentSegment(static_cast<const char*>(data), size));
+    const THeader& header = *segment->Header;
+    const bool isValid = std::memcmp(header.Magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) == 0
+        && header.Version == SEGMENT_VERSION
+        && GetLayout(header.Count, header.EmbeddingSize).Heap + header.HeapSize == size;
+    if (!isValid) {
+        LOG_ERROR("Invalid document segment " << path);
+        return nullptr;
+    }
+    const TLayout layout = GetLayout(header.Count, header.EmbeddingSize);
+    const char* base = segment->Data;
+    segment->ValueHashes = reinterpret_cast<const uint64_t*>(base + layout.ValueHashes);
+    segment->FetchTimes = reinterpret_cast<const uint64_t*>(base + layout.FetchTimes);
+    segment->PubTimes = reinterpret_cast<const uint64_t*>(base + layout.PubTimes);
+    segment->Ttls = reinterpret_cast<const uint64_t*>(base + layout.Ttls);
+    segment->Strings = reinterpret_cast<const TStringRef*>(base + layout.Strings);
+    segment->Languages = reinterpret_cast<const uint8_t*>(base + layout.Languages);
+    segment->Categories = reinterpret_cast<const uint8_t*>(base + layout.Categories);
+    segment->Nasty = reinterpret_cast<const uint8_t*>(base + layout.Nasty);
+    segment->Embeddings = reinterpret_cast<const float*>(base + layout.Embeddings);
+    segment->Heap = base + layout.Heap;
+    for (size_t i = 0; i < header.Count * SF_COUNT; ++i) {
+        const TStringRef& ref = segment->Strings[i];
+        if (ref.Offset > header.HeapSize || ref.Size > header.HeapSize - ref.Offset) {
+            LOG_ERROR("Invalid document segment " << path);
+            return nullptr;
+        }
+    }
+    return segment;
+}
+
+TDocumentSegment::TDocumentSegment(const char* data, size_t size)
+    : Data(data)
+    , DataSize(size)
+    , Header(reinterpret_cast<const THeader*>(data))
+{
+}
+
+TDocumentSegment::~TDocumentSegment() {
+    munmap(const_cast<char*>(Data), DataSize);
+}
+
+size_t TDocumentSegment::Size() const {
+    return Header->Count;
+}
+
+size_t TDocumentSegment::GetEmbeddingSize() const {
+    return Header->EmbeddingSize;
+}
+
+std::optional<size_t> TDocumentSegment::Find(std::string_view key) const {
+    size_t begin = 0;
+    size_t end = Size();
+    while (begin < end) {
+        const size_t middle = begin + (end - begin) / 2;
+        if (GetKey(middle) < key) {
+            begin = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+    if (begin < Size() && GetKey(begin) == key) {
+        return begin;
+    }
+    return std::nullopt;
+}
+
+uint64_t TDocumentSegment::GetValueHash(size_t index) const {
+    return ValueHashes[index];
+}
+
+uint64_t TDocumentSegment::GetFetchTime(size_t index) const {
+    return FetchTimes[index];
+}
+
+std::string_view TDocumentSegment::GetKey(size_t index) const {
+    return GetString(index, SF_KEY);
+}
+
+std::string_view TDocumentSegment::GetFileName(size_t index) const {
+    return GetString(index, SF_FILE_NAME);
+}
+
+std::string_view TDocumentSegment::GetTitle(size_t index) const {
+    return GetString(index, SF_TITLE);
+}
+
+const float* TDocumentSegment::GetEmbedding(size_t index) const {
+    return Embeddings + index * Header->EmbeddingSize;
+}
+
+std::string_view TDocumentSegment::GetString(size_t index, size_t field) const {
+    const TStringRef& ref = Strings[index * SF_COUNT + field];
+    return std::string_view(Heap + ref.Offset, ref.Size);
+}
+
+TDbDocument TDocumentSegment::GetDocument(size_t index) const {
+    TDbDocument document;
+    document.FileName = GetString(index, SF_FILE_NAME);
+    document.Url = GetString(index, SF_URL);
+    // Stored instead of parsed from the URL again
+    document.Host = GetString(index, SF_HOST);
+    document.HostId = THostDictionary::Get().Intern(document.Host);
+    document.SiteName = GetString(index, SF_SITE_NAME);
+    document.Title = GetString(index, SF_TITLE);
+    document.PubTime = PubTimes[index];
+    document.FetchTime = FetchTimes[index];
+    document.Ttl = Ttls[index];
+    document.Language = static_cast<tg::ELanguage>(Languages[index]);
+    document.Category = static_cast<tg::ECategory>(Categories[index]);
+    document.Nasty = Nasty[index] != 0;
+    const float* embedding = GetEmbedding(index);
+    document.Embeddings.emplace(tg::EK_FASTTEXT_CLASSIC, TDbDocument::TEmbedding(embedding, embedding + Header->EmbeddingSize));
+    return document;
+}
+
+bool TDocumentSegmentWriter::Add(std::string_view key, uint64_t valueHash, const TDbDocument& document) {
+    const TDbDocument::TEmbedding* embedding = GetClusteringEmbedding(document);
+    if (!embedding || embedding->empty()) {
+        return false;
+    }
+    if (ValueHashes.empty()) {
+        EmbeddingSize = embedding->size();
+    }
+    if (embedding->size() != EmbeddingSize) {
+        return false;
+    }
+    ValueHashes.push_back(valueHash);
+    FetchTimes.push_back(document.FetchTime);
+    PubTimes.push_back(document.PubTime);
+    Ttls.push_back(document.Ttl);
+    AddString(key);
+    AddString(document.FileName);
+    AddString(document.Url);
+    AddString(document.Host);
+    AddString(document.SiteName);
+    AddString(document.Title);
+    Languages.push_back(static_cast<uint8_t>(document.Language));
+    Categories.push_back(static_cast<uint8_t>(document.Category));
+    Nasty.push_back(document.Nasty ? 1 : 0);
+    Embeddings.insert(Embeddings.end(), embedding->begin(), embedding->end());
+    return true;
+}
+
+void TDocumentSegmentWriter::AddString(std::string_view value) {
+    Strings.push_back(Heap.size());
+    Strings.push_back(value.size());
+    Heap.append(value);
+}
+
+bool TDocumentSegmentWriter::Write(const std::string& path) const {
+    const size_t count = ValueHashes.size();
+    const TLayout layout = GetLayout(count, EmbeddingSize);
+    std::string data(layout.Heap, '\0');
+
+    TDocumentSegment::THeader header;
+    std::memcpy(header.Magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    header.Version = SEGMENT_VERSION;
+    header.EmbeddingSize = EmbeddingSize;
+    header.Count = count;
+    header.HeapSize = Heap.size();
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    const auto copyColumn = [&data](size_t offset, const auto& column) {
+        if (!column.empty()) {
+            std::memcpy(data.data() + offset, column.data(), column.size() * sizeof(column[0]));
+        }
+    };
+    copyColumn(layout.ValueHashes, ValueHashes);
+    copyColumn(layout.FetchTimes, FetchTimes);
+    copyColumn(layout.PubTimes, PubTimes);
+    copyColumn(layout.Ttls, Ttls);
+    copyColumn(layout.Strings, Strings);
+    copyColumn(layout.Languages, Languages);
+    copyColumn(layout.Categories, Categories);
+    copyColumn(layout.Nasty, Nasty);
+    copyColumn(layout.Embeddings, Embeddings);
+
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream output(tmpPath, std::ios::binary | std::ios::trunc);
+        output.write(data.data(), data.size());
+        output.write(Heap.data(), Heap.size());
+        if (!output) {
+            LOG_ERROR("Failed to write document segment to " << tmpPath);
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        LOG_ERROR("Failed to rename document segment to " << path);
+        return false;
+    }
+    return true;
+}
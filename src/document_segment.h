@@ -0,0 +1,87 @@
+#pragma once
+
+#include "db_document.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Columnar file with the document fields needed for clustering: fixed-width arrays and a string heap.
+// Rows are sorted by DB key and keep a hash of the source DB value, so unchanged documents
+// can be taken from the segment instead of decoding their protobufs.
+// Only EK_FASTTEXT_CLASSIC embeddings are stored; text, description and links are not.
+class TDocumentSegment {
+public:
+    // Memory maps the file, nullptr if it is missing or invalid
+    static std::unique_ptr<TDocumentSegment> Open(const std::string& path);
+    ~TDocumentSegment();
+
+    TDocumentSegment(const TDocumentSegment&) = delete;
+    TDocumentSegment& operator=(const TDocumentSegment&) = delete;
+
+    size_t Size() const;
+    size_t GetEmbeddingSize() const;
+    std::optional<size_t> Find(std::string_view key) const;
+
+    std::string_view GetKey(size_t index) const;
+    uint64_t GetValueHash(size_t index) const;
+    uint64_t GetFetchTime(size_t index) const;
+    std::string_view GetFileName(size_t index) const;
+    std::string_view GetTitle(size_t index) const;
+    const float* GetEmbedding(size_t index) const;
+
+    TDbDocument GetDocument(size_t index) const;
+
+public:
+    struct THeader;
+    struct TStringRef;
+
+private:
+    TDocumentSegment(const char* data, size_t size);
+    std::string_view GetString(size_t index, size_t field) const;
+
+private:
+    const char* Data = nullptr;
+    size_t DataSize = 0;
+
+    const THeader* Header = nullptr;
+    const uint64_t* ValueHashes = nullptr;
+    const uint64_t* FetchTimes = nullptr;
+    const uint64_t* PubTimes = nullptr;
+    const uint64_t* Ttls = nullptr;
+    const TStringRef* Strings = nullptr;
+    const uint8_t* Languages = nullptr;
+    const uint8_t* Categories = nullptr;
+    const uint8_t* Nasty = nullptr;
+    const float* Embeddings = nullptr;
+    const char* Heap = nullptr;
+};
+
+class TDocumentSegmentWriter {
+public:
+    // Documents must be added in key order.
+    // Returns false for documents without a clustering embedding of the segment size, they are skipped.
+    bool Add(std::string_view key, uint64_t valueHash, const TDbDocument& document);
+
+    // Written to a temporary file first, so an open segment with the same path stays valid
+    bool Write(const std::string& path) const;
+
+private:
+    void AddString(std::string_view value);
+
+private:
+    size_t EmbeddingSize = 0;
+    std::vector<uint64_t> ValueHashes;
+    std::vector<uint64_t> FetchTimes;
+    std::vector<uint64_t> PubTimes;
+    std::vector<uint64_t> Ttls;
+    std::vector<uint64_t> Strings;
+    std::vector<uint8_t> Languages;
+    std::vector<uint8_t> Categories;
+    std::vector<uint8_t> Nasty;
+    std::vector<float> Embeddings;
+    std::string Heap;
+};
@@ -0,0 +1,33 @@
+#include "document_store.h"
+
+#include "util.h"
+
+TEmbeddingMatrix::TEmbeddingMatrix(std::vector<TDbDocument>& documents, tg::EEmbeddingKey key) {
+    if (documents.empty()) {
+        return;
+    }
+    const size_t embeddingSize = documents.front().Embeddings.at(key).size();
+    Data.resize(documents.size(), embeddingSize);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        auto it = documents[i].Embeddings.find(key);
+        ENSURE(it != documents[i].Embeddings.end() && it->second.size() == embeddingSize, "Bad embedding in " << documents[i].FileName);
+        Eigen::Map<const Eigen::VectorXf> embedding(it->second.data(), it->second.size());
+        Data.row(i) = embedding / embedding.norm();
+        documents[i].Embeddings.erase(it);
+    }
+}
+
+TEmbeddingMatrix::TRowsMap TEmbeddingMatrix::GetRows(size_t begin, size_t count) const {
+    assert(begin + count <= GetRowCount());
+    return TRowsMap(Data.data() + begin * Data.cols(), count, Data.cols());
+}
+
+TEmbeddingMatrix::TRowMap TEmbeddingMatrix::GetRow(size_t index) const {
+    assert(index < GetRowCount());
+    return TRowMap(Data.data() + index * Data.cols(), Data.cols());
+}
+
+TEmbeddingMatrix::TRowMap TLanguageDocuments::GetEmbedding(const TDbDocument& document) const {
+    assert(&document >= Documents.data() && &document < Documents.data() + Documents.size());
+    return Embeddings.GetRow(&document - Documents.data());
+}
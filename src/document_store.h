@@ -0,0 +1,39 @@
+#pragma once
+
+#include "db_document.h"
+
+#include <Eigen/Core>
+
+#include <unordered_map>
+#include <vector>
+
+// Normalized embeddings of one key in a single row-major matrix, one row per document
+class TEmbeddingMatrix {
+public:
+    using TMatrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    using TRowsMap = Eigen::Map<const TMatrix>;
+    using TRowMap = Eigen::Map<const Eigen::VectorXf>;
+
+    TEmbeddingMatrix() = default;
+    // Moves the embeddings out of the documents, every document must have one of the same size
+    TEmbeddingMatrix(std::vector<TDbDocument>& documents, tg::EEmbeddingKey key);
+
+    size_t GetRowCount() const { return Data.rows(); }
+    size_t GetEmbeddingSize() const { return Data.cols(); }
+    TRowsMap GetRows(size_t begin, size_t count) const;
+    TRowMap GetRow(size_t index) const;
+
+private:
+    TMatrix Data;
+};
+
+// Documents of one language in clustering order with their clustering embeddings
+struct TLanguageDocuments {
+    std::vector<TDbDocument> Documents;
+    TEmbeddingMatrix Embeddings;
+
+    // The document must be an element of Documents
+    TEmbeddingMatrix::TRowMap GetEmbedding(const TDbDocument& document) const;
+};
+
+using TDocumentStore = std::unordered_map<tg::ELanguage, TLanguageDocuments>;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../token_span.h"
+#include "../tokenized_document.h"
 #include "config.pb.h"
 #include "enum.pb.h"
 
@@ -9,18 +11,17 @@ public:
 
     virtual ~TEmbedder() = default;
 
-    virtual std::vector<float> CalcEmbedding(const std::string& input) const = 0;
+    virtual std::vector<float> CalcEmbedding(TTokenSpan tokens) const = 0;
 
-    std::vector<float> CalcEmbedding(const std::string& title, const std::string& text) const {
-        std::string input;
+    std::vector<float> CalcEmbedding(const TTokenizedDocument& document) const {
         if (Field == tg::EF_ALL) {
-            input = title + " " + text;
+            return CalcEmbedding(document.GetAll());
         } else if (Field == tg::EF_TITLE) {
-            input = title;
+            return CalcEmbedding(document.GetTitle());
         } else if (Field == tg::EF_TEXT) {
-            input = text;
+            return CalcEmbedding(document.GetText());
         }
-        return CalcEmbedding(input);
+        return CalcEmbedding(TTokenSpan());
     }
 
 protected:
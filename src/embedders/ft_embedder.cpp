@@ -1,11 +1,8 @@
 #include "ft_embedder.h"
 #include "../util.h"
 
-#include <sstream>
 #include <cassert>
 
-#include <onmt/Tokenizer.h>
-
 TFastTextEmbedder::TFastTextEmbedder(
     const std::string& vectorModelPath
     , tg::EEmbedderField field
@@ -35,8 +32,7 @@ TFastTextEmbedder::TFastTextEmbedder(tg::TEmbedderConfig config) : TFastTextEmbe
     config.model_path()
 ) {}
 
-std::vector<float> TFastTextEmbedder::CalcEmbedding(const std::string& input) const {
-    std::istringstream ss(input);
+std::vector<float> TFastTextEmbedder::CalcEmbedding(TTokenSpan tokens) const {
     size_t vectorSize = VectorModel.getDimension();
     fasttext::Vector wordVector(vectorSize);
     fasttext::Vector avgVector(vectorSize);
@@ -44,10 +40,11 @@ std::vector<float> TFastTextEmbedder::CalcEmbedding(const std::string& input) co
     fasttext::Vector minVector(vectorSize);
     std::string word;
     size_t count = 0;
-    while (ss >> word) {
+    for (const std::string_view& token : tokens) {
         if (count > MaxWords) {
             break;
         }
+        word.assign(token);
         VectorModel.getWordVector(wordVector, word);
         float norm = wordVector.norm();
         if (norm < 0.0001f) {
@@ -23,7 +23,9 @@ public:
 
     explicit TFastTextEmbedder(tg::TEmbedderConfig config);
 
-    std::vector<float> CalcEmbedding(const std::string& input) const override;
+    using TEmbedder::CalcEmbedding;
+
+    std::vector<float> CalcEmbedding(TTokenSpan tokens) const override;
 
 private:
     tg::EAggregationMode Mode;
@@ -1,11 +1,13 @@
 #pragma once
 
-#include <boost/algorithm/string.hpp>
-#include <boost/algorithm/string/split.hpp>
+#include "../token_span.h"
+
 #include <torch/script.h>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class TTokenIndexer {
@@ -20,25 +22,28 @@ public:
         }
     }
 
-    torch::Tensor Index(const std::string& text) const {
-        std::vector<std::string> words;
-        boost::split(words, text, boost::is_any_of(" "), boost::token_compress_on);
-        if (words.empty()) {
-            return torch::zeros({1}, torch::requires_grad(false));
+    torch::Tensor Index(TTokenSpan tokens) const {
+        if (tokens.empty()) {
+            // Same as the single empty word the old whitespace split produced
+            torch::Tensor inputs = torch::zeros({1}, torch::dtype(torch::kLong));
+            inputs[0] = static_cast<int>(GetIndex(""));
+            return inputs;
         }
-        torch::Tensor inputs = torch::zeros({static_cast<long long>(words.size())}, torch::dtype(torch::kLong));
-        for (size_t i = 0; i < std::min(words.size(), MaxWords); i++) {
-            auto it = Vocabulary.find(words[i]);
-            if (it != Vocabulary.end()) {
-                inputs[i] = static_cast<int>(it->second);
-            } else {
-                inputs[i] = 0;
-            }
+        torch::Tensor inputs = torch::zeros({static_cast<long long>(tokens.size())}, torch::dtype(torch::kLong));
+        std::string word;
+        for (size_t i = 0; i < std::min(tokens.size(), MaxWords); i++) {
+            word.assign(tokens[i]);
+            inputs[i] = static_cast<int>(GetIndex(word));
         }
         return inputs;
     }
 
 private:
+    size_t GetIndex(const std::string& word) const {
+        auto it = Vocabulary.find(word);
+        return it != Vocabulary.end() ? it->second : 0;
+    }
+
     std::unordered_map<std::string, size_t> Vocabulary;
     size_t MaxWords = 0;
 };
@@ -21,8 +21,8 @@ TTorchEmbedder::TTorchEmbedder(tg::TEmbedderConfig config) : TTorchEmbedder(
     config.max_words()
 ) {}
 
-std::vector<float> TTorchEmbedder::CalcEmbedding(const std::string& input) const {
-    auto tensor = TokenIndexer.Index(input);
+std::vector<float> TTorchEmbedder::CalcEmbedding(TTokenSpan tokens) const {
+    auto tensor = TokenIndexer.Index(tokens);
     std::vector<torch::jit::IValue> inputs;
     inputs.emplace_back(tensor.unsqueeze(0));
     at::Tensor outputTensor = Model.forward(inputs).toTensor().squeeze(0).contiguous();
@@ -15,7 +15,9 @@ public:
 
     explicit TTorchEmbedder(tg::TEmbedderConfig config);
 
-    std::vector<float> CalcEmbedding(const std::string& input) const override;
+    using TEmbedder::CalcEmbedding;
+
+    std::vector<float> CalcEmbedding(TTokenSpan tokens) const override;
 
 private:
     mutable torch::jit::script::Module Model;
@@ -0,0 +1,41 @@
+#include "host_dictionary.h"
+
+#include <mutex>
+
+THostDictionary& THostDictionary::Get() {
+    static THostDictionary dictionary;
+    return dictionary;
+}
+
+THostDictionary::THostDictionary() {
+    Intern("");
+}
+
+THostId THostDictionary::Intern(std::string_view host) {
+    {
+        std::shared_lock<std::shared_mutex> lock(Mutex);
+        const auto it = Ids.find(host);
+        if (it != Ids.end()) {
+            return it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(Mutex);
+    const auto it = Ids.find(host);
+    if (it != Ids.end()) {
+        return it->second;
+    }
+    const THostId id = Hosts.size();
+    const std::string& stored = Hosts.emplace_back(host);
+    Ids.emplace(stored, id);
+    return id;
+}
+
+const std::string& THostDictionary::GetHost(THostId id) const {
+    std::shared_lock<std::shared_mutex> lock(Mutex);
+    return Hosts.at(id);
+}
+
+size_t THostDictionary::Size() const {
+    std::shared_lock<std::shared_mutex> lock(Mutex);
+    return Hosts.size();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using THostId = uint32_t;
+
+// Process-wide dictionary of hosts with dense ids, shared by documents and agency ratings.
+// Id 0 is the empty host, so default-constructed documents have a valid id.
+class THostDictionary {
+public:
+    static THostDictionary& Get();
+
+    // Thread-safe, returns the same id for the same host
+    THostId Intern(std::string_view host);
+    const std::string& GetHost(THostId id) const;
+    size_t Size() const;
+
+private:
+    THostDictionary();
+
+private:
+    mutable std::shared_mutex Mutex;
+    std::deque<std::string> Hosts;
+    std::unordered_map<std::string_view, THostId> Ids;
+};
@@ -0,0 +1,112 @@
+#include "index_snapshot.h"
+
+#include "index_snapshot.pb.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+    constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+    tg::TDocumentProto ToServingProto(const TDbDocument& document) {
+        tg::TDocumentProto proto;
+        proto.set_file_name(document.FileName);
+        proto.set_url(document.Url);
+        proto.set_site_name(document.SiteName);
+        proto.set_pub_time(document.PubTime);
+        proto.set_fetch_time(document.FetchTime);
+        proto.set_ttl(document.Ttl);
+        proto.set_title(document.Title);
+        proto.set_language(document.Language);
+        proto.set_category(document.Category);
+        proto.set_nasty(document.Nasty);
+        return proto;
+    }
+
+}
+
+bool SaveIndexSnapshot(const TClusterIndex& index, const std::string& path) {
+    tg::TClusterIndexSnapshotProto snapshot;
+    snapshot.set_version(SNAPSHOT_VERSION);
+    snapshot.set_iter_timestamp(index.IterTimestamp);
+    snapshot.set_true_max_timestamp(index.TrueMaxTimestamp);
+    for (const auto& [language, clusters] : index.Clusters) {
+        tg::TLanguageSnapshotProto* languageProto = snapshot.add_languages();
+        languageProto->set_language(language);
+        const std::vector<TDbDocument>& documents = index.Documents->at(language).Documents;
+        for (const TDbDocument& document : documents) {
+            *languageProto->add_documents() = ToServingProto(document);
+        }
+        for (const TNewsCluster& cluster : clusters) {
+            *languageProto->add_clusters() = cluster.ToProto(documents);
+        }
+    }
+
+    // Readers never see a partially written snapshot
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream output(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!output || !snapshot.SerializeToOstream(&output)) {
+            LOG_ERROR("Failed to write index snapshot to " << tmpPath);
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        LOG_ERROR("Failed to rename index snapshot to " << path);
+        return false;
+    }
+    return true;
+}
+
+std::optional<TClusterIndex> LoadIndexSnapshot(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        return std::nullopt;
+    }
+    tg::TClusterIndexSnapshotProto snapshot;
+    if (!snapshot.ParseFromIstream(&input)) {
+        LOG_ERROR("Invalid index snapshot " << path);
+        return std::nullopt;
+    }
+    if (snapshot.version() != SNAPSHOT_VERSION) {
+        LOG_ERROR("Index snapshot " << path << " has version " << snapshot.version() << ", expected " << SNAPSHOT_VERSION);
+        return std::nullopt;
+    }
+
+    TClusterIndex index;
+    index.IterTimestamp = snapshot.iter_timestamp();
+    index.TrueMaxTimestamp = snapshot.true_max_timestamp();
+    auto store = std::make_shared<TDocumentStore>();
+    for (const tg::TLanguageSnapshotProto& languageProto : snapshot.languages()) {
+        // Embeddings are not saved, snapshot clusters are already ranked
+        if (store->count(languageProto.language())) {
+            LOG_ERROR("Index snapshot " << path << " has a duplicate language");
+            return std::nullopt;
+        }
+        // Clusters must be valid, the server would fail on them later
+        for (const tg::TNewsClusterProto& clusterProto : languageProto.clusters()) {
+            const bool hasBadIndex = std::any_of(clusterProto.documents().begin(), clusterProto.documents().end(), [&](uint32_t index) {
+                return index >= static_cast<uint32_t>(languageProto.documents_size());
+            });
+            if (clusterProto.documents().empty() || hasBadIndex) {
+                LOG_ERROR("Index snapshot " << path << " has a bad cluster " << clusterProto.id());
+                return std::nullopt;
+            }
+        }
+        std::vector<TDbDocument>& documents = (*store)[languageProto.language()].Documents;
+        documents.reserve(languageProto.documents_size());
+        for (const tg::TDocumentProto& documentProto : languageProto.documents()) {
+            documents.push_back(TDbDocument::FromProto(documentProto));
+        }
+        TClusters& clusters = index.Clusters[languageProto.language()];
+        clusters.reserve(languageProto.clusters_size());
+        for (const tg::TNewsClusterProto& clusterProto : languageProto.clusters()) {
+            clusters.push_back(TNewsCluster::FromProto(clusterProto, documents));
+        }
+    }
+    index.Documents = std::move(store);
+    return index;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "clusterer.h"
+
+#include <optional>
+#include <string>
+
+// Snapshot of a published index: ranked clusters and the documents they refer to.
+// Ranked views are not saved, they are cheap to rebuild.
+bool SaveIndexSnapshot(const TClusterIndex& index, const std::string& path);
+std::optional<TClusterIndex> LoadIndexSnapshot(const std::string& path);
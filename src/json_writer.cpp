@@ -0,0 +1,96 @@
+#include "json_writer.h"
+
+#include "util.h"
+
+TJsonStreamWriter::TJsonStreamWriter(std::ostream& output, int indent)
+    : Output(output)
+    , Indent(indent)
+{
+}
+
+void TJsonStreamWriter::BeginArray() {
+    BeginContainer(/* isArray */ true, '[');
+}
+
+void TJsonStreamWriter::EndArray() {
+    ENSURE(!Levels.empty() && Levels.back().IsArray, "EndArray outside of an array");
+    EndContainer(']');
+}
+
+void TJsonStreamWriter::BeginObject() {
+    BeginContainer(/* isArray */ false, '{');
+}
+
+void TJsonStreamWriter::EndObject() {
+    ENSURE(!Levels.empty() && !Levels.back().IsArray && !HasKey, "EndObject outside of an object");
+    EndContainer('}');
+}
+
+void TJsonStreamWriter::Key(std::string_view key) {
+    ENSURE(!Levels.empty() && !Levels.back().IsArray && !HasKey, "Key outside of an object");
+    BeginItem();
+    Output << nlohmann::json(std::string(key)).dump() << (Indent >= 0 ? ": " : ":");
+    HasKey = true;
+}
+
+void TJsonStreamWriter::Value(const nlohmann::json& value) {
+    BeginItem();
+    Output << Format(value, Levels.size());
+}
+
+void TJsonStreamWriter::Finish() {
+    ENSURE(Levels.empty(), "Unfinished JSON document");
+    Output << std::endl;
+}
+
+void TJsonStreamWriter::BeginContainer(bool isArray, char bracket) {
+    BeginItem();
+    Output << bracket;
+    Levels.push_back(TLevel{isArray, 0});
+}
+
+void TJsonStreamWriter::EndContainer(char bracket) {
+    const bool isEmpty = Levels.back().Count == 0;
+    Levels.pop_back();
+    if (!isEmpty && Indent >= 0) {
+        Output << '\n' << std::string(Levels.size() * Indent, ' ');
+    }
+    Output << bracket;
+}
+
+// Writes what goes before an item: a separator and an indent, nothing after a key
+void TJsonStreamWriter::BeginItem() {
+    if (HasKey) {
+        HasKey = false;
+        return;
+    }
+    if (Levels.empty()) {
+        return;
+    }
+    TLevel& level = Levels.back();
+    if (level.Count != 0) {
+        Output << ',';
+    }
+    if (Indent >= 0) {
+        Output << '\n' << std::string(Levels.size() * Indent, ' ');
+    }
+    ++level.Count;
+}
+
+std::string TJsonStreamWriter::Format(const nlohmann::json& value, size_t depth) const {
+    std::string result = value.dump(Indent);
+    if (Indent <= 0 || depth == 0) {
+        return result;
+    }
+    // Strings in dumped JSON have no raw newlines, so every newline starts a line of the value
+    const std::string padding(depth * Indent, ' ');
+    std::string indented;
+    indented.reserve(result.size());
+    for (const char c : result) {
+        indented += c;
+        if (c == '\n') {
+            indented += padding;
+        }
+    }
+    return indented;
+}
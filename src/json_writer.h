@@ -0,0 +1,90 @@
+#pragma once
+
+#include "thread_pool.h"
+#include "util.h"
+
+#include <nlohmann_json/json.hpp>
+
+#include <deque>
+#include <future>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Writes a JSON document to a stream piece by piece, without building the whole tree.
+// Output is the same as nlohmann::json::dump(indent) of the whole document; indent < 0 is compact.
+class TJsonStreamWriter {
+public:
+    explicit TJsonStreamWriter(std::ostream& output, int indent = 4);
+
+    void BeginArray();
+    void EndArray();
+    void BeginObject();
+    void EndObject();
+    void Key(std::string_view key);
+    void Value(const nlohmann::json& value);
+
+    // Array items toJson(*it) for [begin, end), formatted in parallel and written in order
+    template <class TIterator, class TToJson>
+    void Values(TIterator begin, TIterator end, TToJson&& toJson, size_t threadsCount = std::thread::hardware_concurrency());
+
+    // Ends the document with a newline and flushes the stream
+    void Finish();
+
+private:
+    struct TLevel {
+        bool IsArray = false;
+        size_t Count = 0;
+    };
+
+    void BeginContainer(bool isArray, char bracket);
+    void EndContainer(char bracket);
+    void BeginItem();
+    std::string Format(const nlohmann::json& value, size_t depth) const;
+
+private:
+    std::ostream& Output;
+    const int Indent;
+    std::vector<TLevel> Levels;
+    bool HasKey = false;
+};
+
+template <class TIterator, class TToJson>
+void TJsonStreamWriter::Values(TIterator begin, TIterator end, TToJson&& toJson, size_t threadsCount) {
+    static constexpr size_t CHUNK_SIZE = 256;
+    ENSURE(!Levels.empty() && Levels.back().IsArray, "Values outside of an array");
+    const size_t depth = Levels.size();
+    const auto formatChunk = [this, &toJson, depth](TIterator chunkBegin, TIterator chunkEnd) {
+        std::vector<std::string> values;
+        for (TIterator it = chunkBegin; it != chunkEnd; ++it) {
+            values.push_back(Format(toJson(*it), depth));
+        }
+        return values;
+    };
+
+    // At most two chunks per thread are formatted ahead of the output
+    TThreadPool& threadPool = TThreadPool::Get();
+    std::deque<std::future<std::vector<std::string>>> chunks;
+    const auto writeChunk = [this, &chunks] {
+        for (const std::string& value : chunks.front().get()) {
+            BeginItem();
+            Output << value;
+        }
+        chunks.pop_front();
+    };
+    while (begin != end) {
+        TIterator chunkEnd = begin;
+        for (size_t i = 0; i < CHUNK_SIZE && chunkEnd != end; ++i) {
+            ++chunkEnd;
+        }
+        chunks.push_back(threadPool.enqueue(formatChunk, begin, chunkEnd));
+        begin = chunkEnd;
+        if (chunks.size() >= 2 * std::max<size_t>(threadsCount, 1)) {
+            writeChunk();
+        }
+    }
+    while (!chunks.empty()) {
+        writeChunk();
+    }
+}
@@ -1,5 +1,7 @@
 #include "annotator.h"
 #include "clusterer.h"
+#include "corpus.h"
+#include "json_writer.h"
 #include "rank.h"
 #include "run_server.h"
 #include "timer.h"
@@ -19,12 +21,16 @@ int main(int argc, char** argv) {
             ("input", po::value<std::string>()->required(), "input")
             ("server_config", po::value<std::string>()->default_value("configs/server.pbtxt"), "server_config")
             ("annotator_config", po::value<std::string>()->default_value("configs/annotator.pbtxt"), "annotator_config")
+            ("annotation_cache", po::value<std::string>()->default_value(""), "annotation_cache")
             ("clusterer_config", po::value<std::string>()->default_value("configs/clusterer.pbtxt"), "clusterer_config")
             ("ndocs", po::value<int>()->default_value(-1), "ndocs")
             ("save_not_news", po::bool_switch()->default_value(false), "save_not_news")
             ("languages", po::value<std::vector<std::string>>()->multitoken()->default_value(std::vector<std::string>{"ru", "en"}, "ru en"), "languages")
             ("window_size", po::value<uint64_t>()->default_value(3600*8), "window_size")
             ("print_top_debug_info", po::bool_switch()->default_value(false), "print_top_debug_info")
+            ("compact_json", po::bool_switch()->default_value(false), "compact_json")
+            ("output", po::value<std::string>()->default_value("corpus.bin"), "output")
+            ("ignore_fingerprint", po::bool_switch()->default_value(false), "ignore_fingerprint")
             ;
 
         po::positional_options_description p;
@@ -52,6 +58,7 @@ int main(int argc, char** argv) {
             "categories",
             "threads",
             "top",
+            "annotate",
             "server"
         };
         if (std::find(modes.begin(), modes.end(), mode) == modes.end()) {
@@ -80,72 +87,126 @@ int main(int argc, char** argv) {
             return RunServer(serverConfig, port.value());
         }
 
-        // Read file names
-        LOG_DEBUG("Reading file names...");
         std::string input = vm["input"].as<std::string>();
-        tg::EInputFormat inputFormat = tg::IF_UNDEFINED;
-        std::vector<std::string> fileNames;
-        if (boost::algorithm::ends_with(input, ".json")) {
-            inputFormat = tg::IF_JSON;
-            fileNames.push_back(input);
-            LOG_DEBUG("JSON file as input");
-        } else if (boost::algorithm::ends_with(input, ".jsonl")) {
-            inputFormat = tg::IF_JSONL;
-            fileNames.push_back(input);
-            LOG_DEBUG("JSONL file as input");
+        bool saveNotNews = vm["save_not_news"].as<bool>();
+        std::vector<TDbDocument> docs;
+        if (mode != "annotate" && IsCorpusFile(input)) {
+            // Documents annotated earlier by the annotate mode
+            if (mode != "threads" && mode != "top" && mode != "categories" && mode != "news") {
+                std::cerr << "Corpus input is not supported in mode " << mode << std::endl;
+                return -1;
+            }
+            TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> corpusTimer;
+            TCorpus corpus = ReadCorpus(input);
+            // The corpus must be annotated the same way as this run would annotate the input
+            const uint64_t fingerprint = TAnnotator::CalcFingerprint(
+                vm["annotator_config"].as<std::string>(),
+                vm["languages"].as<std::vector<std::string>>(),
+                saveNotNews,
+                mode);
+            if (corpus.AnnotatorFingerprint != fingerprint && !vm["ignore_fingerprint"].as<bool>()) {
+                std::cerr << "Corpus " << input << " was annotated with another config, models or options, "
+                    << "annotate it again or pass --ignore_fingerprint" << std::endl;
+                return -1;
+            }
+            docs = std::move(corpus.Documents);
+            LOG_DEBUG("Corpus: " << corpusTimer.Elapsed() << " ms (" << docs.size() << " documents, annotator fingerprint " << corpus.AnnotatorFingerprint << ")");
         } else {
-            inputFormat = tg::IF_HTML;
-            int nDocs = vm["ndocs"].as<int>();
-            ReadFileNames(input, fileNames, nDocs);
-            LOG_DEBUG("Files count: " << fileNames.size());
-        }
+            // Read file names
+            LOG_DEBUG("Reading file names...");
+            tg::EInputFormat inputFormat = tg::IF_UNDEFINED;
+            std::vector<std::string> fileNames;
+            if (boost::algorithm::ends_with(input, ".json")) {
+                inputFormat = tg::IF_JSON;
+                fileNames.push_back(input);
+                LOG_DEBUG("JSON file as input");
+            } else if (boost::algorithm::ends_with(input, ".jsonl")) {
+                inputFormat = tg::IF_JSONL;
+                fileNames.push_back(input);
+                LOG_DEBUG("JSONL file as input");
+            } else {
+                inputFormat = tg::IF_HTML;
+                LOG_DEBUG("HTML directory as input");
+            }
 
-        // Parse files and annotate with classifiers
-        const std::string annotatorConfigPath = vm["annotator_config"].as<std::string>();
-        bool saveNotNews = vm["save_not_news"].as<bool>();
-        std::vector<std::string> languages = vm["languages"].as<std::vector<std::string>>();
-        TAnnotator annotator(annotatorConfigPath, languages, saveNotNews, mode);
-        TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> annotationTimer;
-        std::vector<TDbDocument> docs = annotator.AnnotateAll(fileNames, inputFormat);
-        LOG_DEBUG("Annotation: " << annotationTimer.Elapsed() << " ms (" << docs.size() << " documents)");
+            // Parse files and annotate with classifiers
+            const std::string annotatorConfigPath = vm["annotator_config"].as<std::string>();
+            std::vector<std::string> languages = vm["languages"].as<std::vector<std::string>>();
+            const std::string annotationCachePath = vm["annotation_cache"].as<std::string>();
+            TAnnotator annotator(annotatorConfigPath, languages, saveNotNews, mode, annotationCachePath);
+            TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> annotationTimer;
+            size_t filesCount = 0;
+            const auto source = [&](const TAnnotator::TPathHandler& onPath) {
+                if (inputFormat != tg::IF_HTML) {
+                    for (std::string path : fileNames) {
+                        onPath(std::move(path));
+                    }
+                    return;
+                }
+                // Directory listing runs concurrently with annotation
+                ReadFileNames(input, [&](std::string&& path) {
+                    ++filesCount;
+                    onPath(std::move(path));
+                }, vm["ndocs"].as<int>());
+            };
+            if (mode == "annotate") {
+                const std::string outputPath = vm["output"].as<std::string>();
+                TCorpusWriter corpus(outputPath, annotator.CalcFingerprint());
+                annotator.AnnotateAll(source, inputFormat, [&corpus](TDbDocument&& doc) {
+                    corpus.Add(doc);
+                });
+                corpus.Finish();
+                LOG_DEBUG("Annotation: " << annotationTimer.Elapsed() << " ms (" << corpus.GetCount() << " documents written to " << outputPath << ")");
+                return 0;
+            }
+            annotator.AnnotateAll(source, inputFormat, [&docs](TDbDocument&& doc) {
+                docs.push_back(std::move(doc));
+            });
+            if (inputFormat == tg::IF_HTML) {
+                LOG_DEBUG("Files count: " << filesCount);
+            }
+            LOG_DEBUG("Annotation: " << annotationTimer.Elapsed() << " ms (" << docs.size() << " documents)");
+        }
 
         // Output
+        TJsonStreamWriter output(std::cout, vm["compact_json"].as<bool>() ? -1 : 4);
         if (mode == "languages") {
-            nlohmann::json outputJson = nlohmann::json::array();
             std::map<std::string, std::vector<std::string>> langToFiles;
             for (const TDbDocument& doc : docs) {
                 langToFiles[nlohmann::json(doc.Language)].push_back(CleanFileName(doc.FileName));
             }
+            output.BeginArray();
             for (const auto& pair : langToFiles) {
                 const std::string& language = pair.first;
                 const std::vector<std::string>& files = pair.second;
-                nlohmann::json object = {
+                output.Value({
                     {"lang_code", language},
                     {"articles", files}
-                };
-                outputJson.push_back(object);
+                });
             }
-            std::cout << outputJson.dump(4) << std::endl;
+            output.EndArray();
+            output.Finish();
             return 0;
         } else if (mode == "json") {
-            nlohmann::json outputJson = nlohmann::json::array();
-            for (const TDbDocument& doc : docs) {
-                outputJson.push_back(doc.ToJson());
-            }
-            std::cout << outputJson.dump(4) << std::endl;
+            output.BeginArray();
+            output.Values(docs.cbegin(), docs.cend(), [](const TDbDocument& doc) {
+                return doc.ToJson();
+            });
+            output.EndArray();
+            output.Finish();
             return 0;
         } else if (mode == "news") {
-            nlohmann::json articles = nlohmann::json::array();
+            output.BeginObject();
+            output.Key("articles");
+            output.BeginArray();
             for (const TDbDocument& doc : docs) {
-                articles.push_back(CleanFileName(doc.FileName));
+                output.Value(CleanFileName(doc.FileName));
             }
-            nlohmann::json outputJson = nlohmann::json::object();
-            outputJson["articles"] = articles;
-            std::cout << outputJson.dump(4) << std::endl;
+            output.EndArray();
+            output.EndObject();
+            output.Finish();
             return 0;
         } else if (mode == "categories") {
-            nlohmann::json outputJson = nlohmann::json::array();
-
             std::vector<std::vector<std::string>> catToFiles(tg::ECategory_ARRAYSIZE);
             for (const TDbDocument& doc : docs) {
                 tg::ECategory category = doc.Category;
@@ -155,6 +216,7 @@ int main(int argc, char** argv) {
                 catToFiles[static_cast<size_t>(category)].push_back(CleanFileName(doc.FileName));
                 LOG_DEBUG(category << "\t" << doc.Title);
             }
+            output.BeginArray();
             for (size_t i = 0; i < tg::ECategory_ARRAYSIZE; i++) {
                 tg::ECategory category = static_cast<tg::ECategory>(i);
                 if (category == tg::NC_UNDEFINED || category == tg::NC_ANY) {
@@ -164,13 +226,13 @@ int main(int argc, char** argv) {
                     continue;
                 }
                 const std::vector<std::string>& files = catToFiles[i];
-                nlohmann::json object = {
+                output.Value({
                     {"category", category},
                     {"articles", files}
-                };
-                outputJson.push_back(object);
+                });
             }
-            std::cout << outputJson.dump(4) << std::endl;
+            output.EndArray();
+            output.Finish();
             return 0;
         } else if (mode != "threads" && mode != "top") {
             assert(false);
@@ -178,7 +240,9 @@ int main(int argc, char** argv) {
 
         // Clustering
         const std::string clustererConfigPath = vm["clusterer_config"].as<std::string>();
-        TClusterer clusterer(clustererConfigPath);
+        // Features are only printed as top debug info
+        const bool printTopDebugInfo = vm["print_top_debug_info"].as<bool>();
+        TClusterer clusterer(clustererConfigPath, mode == "top" && printTopDebugInfo);
         TTimer<std::chrono::high_resolution_clock, std::chrono::milliseconds> clusteringTimer;
         TClusterIndex clusterIndex = clusterer.Cluster(std::move(docs));
         LOG_DEBUG("Clustering: " << clusteringTimer.Elapsed() << " ms")
@@ -186,7 +250,7 @@ int main(int argc, char** argv) {
             LOG_DEBUG(nlohmann::json(language) << ": " << langClusters.size() << " clusters");
         }
         if (mode == "threads") {
-            nlohmann::json outputJson = nlohmann::json::array();
+            output.BeginArray();
             for (const auto& [language, langClusters]: clusterIndex.Clusters) {
                 for (const auto& cluster : langClusters) {
                     nlohmann::json files = nlohmann::json::array();
@@ -197,7 +261,7 @@ int main(int argc, char** argv) {
                         {"title", cluster.GetTitle()},
                         {"articles", files}
                     };
-                    outputJson.push_back(object);
+                    output.Value(object);
 
                     if (cluster.GetSize() >= 2) {
                         LOG_DEBUG("\n         CLUSTER: " << cluster.GetTitle());
@@ -207,7 +271,8 @@ int main(int argc, char** argv) {
                     }
                 }
             }
-            std::cout << outputJson.dump(4) << std::endl;
+            output.EndArray();
+            output.Finish();
             return 0;
         } else if (mode != "top") {
             assert(false);
@@ -215,7 +280,6 @@ int main(int argc, char** argv) {
 
         // Ranking
         uint64_t window = vm["window_size"].as<uint64_t>();
-        bool printTopDebugInfo = vm["print_top_debug_info"].as<bool>();
         TClusters allClusters;
         for (const auto& language: {tg::LN_EN, tg::LN_RU}) {
             if (clusterIndex.Clusters.find(language) == clusterIndex.Clusters.end()) {
@@ -228,7 +292,7 @@ int main(int argc, char** argv) {
             );
         }
         const auto tops = Rank(allClusters.begin(), allClusters.end(), clusterIndex.IterTimestamp, window);
-        nlohmann::json outputJson = nlohmann::json::array();
+        output.BeginArray();
         for (auto it = tops.begin(); it != tops.end(); ++it) {
             const auto category = static_cast<tg::ECategory>(std::distance(tops.begin(), it));
             if (category == tg::NC_UNDEFINED) {
@@ -238,10 +302,11 @@ int main(int argc, char** argv) {
                 continue;
             }
 
-            nlohmann::json rubricTop = {
-                {"category", category},
-                {"threads", nlohmann::json::array()}
-            };
+            output.BeginObject();
+            output.Key("category");
+            output.Value(category);
+            output.Key("threads");
+            output.BeginArray();
             for (const auto& cluster : *it) {
                 nlohmann::json object = {
                     {"title", cluster.Cluster.get().GetTitle()},
@@ -258,12 +323,12 @@ int main(int argc, char** argv) {
                     object["importance"] = cluster.WeightInfo.Importance;
                     object["best_time"] = cluster.WeightInfo.BestTime;
                     object["age_penalty"] = cluster.WeightInfo.AgePenalty;
-                    object["average_us"] = cluster.Cluster.get().GetCountryShare().at("US");
-                    object["w_average_us"] = cluster.Cluster.get().GetWeightedCountryShare().at("US");
-                    object["average_gb"] = cluster.Cluster.get().GetCountryShare().at("GB");
-                    object["w_average_gb"] = cluster.Cluster.get().GetWeightedCountryShare().at("GB");
-                    object["average_in"] = cluster.Cluster.get().GetCountryShare().at("IN");
-                    object["w_average_in"] = cluster.Cluster.get().GetWeightedCountryShare().at("IN");
+                    object["average_us"] = cluster.Cluster.get().GetCountryShare()[CC_US];
+                    object["w_average_us"] = cluster.Cluster.get().GetWeightedCountryShare()[CC_US];
+                    object["average_gb"] = cluster.Cluster.get().GetCountryShare()[CC_GB];
+                    object["w_average_gb"] = cluster.Cluster.get().GetWeightedCountryShare()[CC_GB];
+                    object["average_in"] = cluster.Cluster.get().GetCountryShare()[CC_IN];
+                    object["w_average_in"] = cluster.Cluster.get().GetWeightedCountryShare()[CC_IN];
 
                     for (const auto& weight : cluster.Cluster.get().GetDocWeights()) {
                         object["article_weights"].push_back(weight);
@@ -273,11 +338,13 @@ int main(int argc, char** argv) {
                     }
 
                 }
-                rubricTop["threads"].push_back(object);
+                output.Value(object);
             }
-            outputJson.push_back(rubricTop);
+            output.EndArray();
+            output.EndObject();
         }
-        std::cout << outputJson.dump(4) << std::endl;
+        output.EndArray();
+        output.Finish();
         return 0;
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -1,6 +1,11 @@
 #include "rank.h"
 #include "util.h"
 
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <numeric>
+
 TWeightInfo ComputeClusterWeightPush(
     const TNewsCluster& cluster,
     const uint64_t iterTimestamp,
@@ -19,38 +24,112 @@ TWeightInfo ComputeClusterWeightPush(
     return TWeightInfo{clusterTime, rank, timeMultiplier, rank * timeMultiplier, cluster.GetSize()};
 }
 
+namespace {
+
+bool IsRankedBefore(const TWeightInfo& a, const TWeightInfo& b) {
+    if (a.ClusterSize == b.ClusterSize) {
+        return a.Weight > b.Weight;
+    }
+    if (a.ClusterSize < 3 || b.ClusterSize < 3) {
+        return a.ClusterSize > b.ClusterSize;
+    }
+    return a.Weight > b.Weight;
+}
+
+// First limit clusters of weightedClusters[indices] in rank order.
+// Ties are broken by position, so the order is the same as after a full stable_sort.
+std::vector<TWeightedNewsCluster> SelectTop(
+    const std::vector<TWeightedNewsCluster>& weightedClusters,
+    std::vector<size_t>& indices,
+    size_t limit
+) {
+    const size_t topSize = std::min(limit, indices.size());
+    std::partial_sort(indices.begin(), indices.begin() + topSize, indices.end(), [&](size_t i, size_t j) {
+        const TWeightInfo& a = weightedClusters[i].WeightInfo;
+        const TWeightInfo& b = weightedClusters[j].WeightInfo;
+        if (IsRankedBefore(a, b)) {
+            return true;
+        }
+        if (IsRankedBefore(b, a)) {
+            return false;
+        }
+        return i < j;
+    });
+
+    std::vector<TWeightedNewsCluster> output;
+    output.reserve(topSize);
+    for (size_t i = 0; i < topSize; ++i) {
+        output.push_back(weightedClusters[indices[i]]);
+    }
+    return output;
+}
+
+}
+
 std::vector<std::vector<TWeightedNewsCluster>> Rank(
     TClusters::const_iterator begin,
     TClusters::const_iterator end,
     uint64_t iterTimestamp,
-    uint64_t window
+    uint64_t window,
+    size_t limit
 ) {
     std::vector<TWeightedNewsCluster> weightedClusters;
+    weightedClusters.reserve(std::distance(begin, end));
+    std::vector<std::vector<size_t>> categoryIndices(tg::ECategory_ARRAYSIZE);
     for (TClusters::const_iterator it = begin; it != end; it++) {
         const TNewsCluster& cluster = *it;
-        const TWeightInfo weight = ComputeClusterWeightPush(cluster, iterTimestamp, window);
-        weightedClusters.emplace_back(cluster, std::move(weight));
-    }
-
-    std::stable_sort(weightedClusters.begin(), weightedClusters.end(),
-        [](const TWeightedNewsCluster& a, const TWeightedNewsCluster& b) {
-            if (a.WeightInfo.ClusterSize == b.WeightInfo.ClusterSize) {
-                return a.WeightInfo.Weight > b.WeightInfo.Weight;
-            }
-            if (a.WeightInfo.ClusterSize < 3 || b.WeightInfo.ClusterSize < 3) {
-                return a.WeightInfo.ClusterSize > b.WeightInfo.ClusterSize;
-            }
-            return a.WeightInfo.Weight > b.WeightInfo.Weight;
-        }
-    );
-
-    std::vector<std::vector<TWeightedNewsCluster>> output(tg::ECategory_ARRAYSIZE);
-    for (const TWeightedNewsCluster& cluster : weightedClusters) {
-        auto category = cluster.Cluster.get().GetCategory();
+        const auto category = cluster.GetCategory();
         assert(category != tg::NC_UNDEFINED && category != tg::NC_ANY);
-        output[static_cast<size_t>(category)].push_back(cluster);
-        output[static_cast<size_t>(tg::NC_ANY)].push_back(cluster);
+        categoryIndices[static_cast<size_t>(category)].push_back(weightedClusters.size());
+        weightedClusters.emplace_back(cluster, ComputeClusterWeightPush(cluster, iterTimestamp, window));
     }
+    categoryIndices[static_cast<size_t>(tg::NC_ANY)].resize(weightedClusters.size());
+    std::iota(categoryIndices[static_cast<size_t>(tg::NC_ANY)].begin(), categoryIndices[static_cast<size_t>(tg::NC_ANY)].end(), 0);
 
+    std::vector<std::vector<TWeightedNewsCluster>> output(tg::ECategory_ARRAYSIZE);
+    for (size_t category = 0; category < output.size(); ++category) {
+        output[category] = SelectTop(weightedClusters, categoryIndices[category], limit);
+    }
     return output;
 }
+
+std::vector<TWeightedNewsCluster> RankTop(
+    TClusters::const_iterator begin,
+    TClusters::const_iterator end,
+    uint64_t iterTimestamp,
+    uint64_t window,
+    tg::ECategory category,
+    size_t limit
+) {
+    std::vector<TWeightedNewsCluster> weightedClusters;
+    for (TClusters::const_iterator it = begin; it != end; it++) {
+        const TNewsCluster& cluster = *it;
+        if (category != tg::NC_ANY && cluster.GetCategory() != category) {
+            continue;
+        }
+        weightedClusters.emplace_back(cluster, ComputeClusterWeightPush(cluster, iterTimestamp, window));
+    }
+
+    std::vector<size_t> indices(weightedClusters.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    return SelectTop(weightedClusters, indices, limit);
+}
+
+std::vector<TRankedView> BuildRankedViews(
+    const TClusters& clusters,
+    uint64_t trueMaxTimestamp,
+    uint64_t iterTimestamp,
+    const std::vector<uint64_t>& periods,
+    size_t limit
+) {
+    std::vector<TRankedView> views;
+    views.reserve(periods.size());
+    for (const uint64_t period : periods) {
+        const uint64_t fromTimestamp = trueMaxTimestamp > period ? trueMaxTimestamp - period : 0;
+        const auto begin = std::lower_bound(clusters.cbegin(), clusters.cend(), fromTimestamp, TNewsCluster::Compare);
+        TRankedView& view = views.emplace_back();
+        view.Period = period;
+        view.Categories = Rank(begin, clusters.cend(), iterTimestamp, period, limit);
+    }
+    return views;
+}
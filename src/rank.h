@@ -1,8 +1,11 @@
+#pragma once
+
 #include "agency_rating.h"
 #include "clustering/clustering.h"
 #include "db_document.h"
 
 #include <cstdint>
+#include <limits>
 #include <unordered_map>
 #include <string>
 #include <vector>
@@ -26,9 +29,39 @@ struct TWeightedNewsCluster {
     {}
 };
 
+// Maximal number of threads in a /threads response
+constexpr size_t MAX_THREADS_COUNT = 1000;
+
+// Clusters of every category in rank order, at most limit per category
 std::vector<std::vector<TWeightedNewsCluster>> Rank(
     TClusters::const_iterator begin,
     TClusters::const_iterator end,
     uint64_t iterTimestamp,
-    uint64_t window
+    uint64_t window,
+    size_t limit = std::numeric_limits<size_t>::max()
+);
+
+// First limit clusters of Rank(...)[category], without sorting the rest
+std::vector<TWeightedNewsCluster> RankTop(
+    TClusters::const_iterator begin,
+    TClusters::const_iterator end,
+    uint64_t iterTimestamp,
+    uint64_t window,
+    tg::ECategory category,
+    size_t limit
+);
+
+// Rank output for a fixed period, truncated to a limit per category
+struct TRankedView {
+    uint64_t Period = 0;
+    std::vector<std::vector<TWeightedNewsCluster>> Categories;
+};
+
+// Views for clusters sorted by freshest timestamp, periods are counted back from trueMaxTimestamp
+std::vector<TRankedView> BuildRankedViews(
+    const TClusters& clusters,
+    uint64_t trueMaxTimestamp,
+    uint64_t iterTimestamp,
+    const std::vector<uint64_t>& periods,
+    size_t limit
 );
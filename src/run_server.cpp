@@ -5,7 +5,9 @@
 #include "clusterer.h"
 #include "config.pb.h"
 #include "controller.h"
+#include "index_snapshot.h"
 #include "server_clustering.h"
+#include "time_index.h"
 #include "util.h"
 
 #include <google/protobuf/text_format.h>
@@ -56,17 +58,31 @@ namespace {
         }
     }
 
-    std::unique_ptr<rocksdb::DB> CreateDatabase(const tg::TServerConfig& config) {
+    std::unique_ptr<rocksdb::DB> CreateDatabase(const tg::TServerConfig& config, std::unique_ptr<TDocumentTimeIndex>* timeIndex) {
         rocksdb::Options options;
         options.IncreaseParallelism();
         options.OptimizeLevelStyleCompaction();
         options.create_if_missing = !config.db_fail_if_missing();
+        options.create_missing_column_families = true;
         options.max_open_files = config.db_max_open_files();
 
+        const std::vector<rocksdb::ColumnFamilyDescriptor> descriptors = {
+            {rocksdb::kDefaultColumnFamilyName, options},
+            {TDocumentTimeIndex::COLUMN_FAMILY, options}
+        };
+        std::vector<rocksdb::ColumnFamilyHandle*> handles;
         rocksdb::DB* db;
-        const rocksdb::Status s = rocksdb::DB::Open(options, config.db_path(), &db);
+        const rocksdb::Status s = rocksdb::DB::Open(options, config.db_path(), descriptors, &handles, &db);
         ENSURE(s.ok(), "Failed to create database: " << s.getState());
 
+        // The default column family handle is owned by the database
+        db->DestroyColumnFamilyHandle(handles[0]);
+        *timeIndex = std::make_unique<TDocumentTimeIndex>(db, handles[1]);
+        // The column family is created at Open, the marker shows that the index is complete
+        if (!(*timeIndex)->IsBuilt()) {
+            (*timeIndex)->Rebuild();
+        }
+
         return std::unique_ptr<rocksdb::DB>(db);
     }
 
@@ -90,7 +106,8 @@ int RunServer(const std::string& fname, uint16_t port) {
     CheckIO(config);
 
     LOG_DEBUG("Creating database");
-    std::unique_ptr<rocksdb::DB> db = CreateDatabase(config);
+    std::unique_ptr<TDocumentTimeIndex> timeIndex;
+    std::unique_ptr<rocksdb::DB> db = CreateDatabase(config, &timeIndex);
 
     LOG_DEBUG("Creating annotator");
     std::vector<std::string> languages = {"ru", "en"};
@@ -99,7 +116,8 @@ int RunServer(const std::string& fname, uint16_t port) {
     LOG_DEBUG("Creating clusterer");
     std::unique_ptr<TClusterer> clusterer = std::make_unique<TClusterer>(config.clusterer_config_path());
 
-    TServerClustering serverClustering(std::move(clusterer), db.get());
+    const std::vector<uint64_t> rankedPeriods(config.ranked_periods().begin(), config.ranked_periods().end());
+    TServerClustering serverClustering(std::move(clusterer), db.get(), timeIndex.get(), rankedPeriods, config.document_segment_path());
 
     LOG_DEBUG("Launching server");
     InitServer(config, port);
@@ -112,14 +130,34 @@ int RunServer(const std::string& fname, uint16_t port) {
     THotState<TClusterIndex> index;
 
     auto initContoller = [&, annotator=std::move(annotator)]() mutable {
-        DrClassMap::getSingleInstance<TController>()->Init(&index, db.get(), std::move(annotator), config.skip_irrelevant_docs());
+        DrClassMap::getSingleInstance<TController>()->Init(&index, db.get(), timeIndex.get(), std::move(annotator), config.skip_irrelevant_docs(), config.gzip_threads());
     };
 
+    // Serve the last published index while the first clustering runs
+    bool firstRun = true;
+    uint64_t generation = 0;
+    const std::string& snapshotPath = config.index_snapshot_path();
+    if (!snapshotPath.empty()) {
+        std::optional<TClusterIndex> snapshot = LoadIndexSnapshot(snapshotPath);
+        if (snapshot) {
+            LOG_DEBUG("Loaded index snapshot " << snapshotPath);
+            serverClustering.AddRankedViews(snapshot.value());
+            snapshot->Generation = ++generation;
+            index.AtomicSet(std::make_shared<TClusterIndex>(std::move(snapshot.value())));
+            initContoller();
+            firstRun = false;
+        }
+    }
+
     std::thread clusteringThread([&, sleep_ms=config.clusterer_sleep()]() {
-        bool firstRun = true;
         while (true) {
             TClusterIndex newIndex = serverClustering.MakeIndex();
-            index.AtomicSet(std::make_shared<TClusterIndex>(std::move(newIndex)));
+            newIndex.Generation = ++generation;
+            auto newIndexPtr = std::make_shared<TClusterIndex>(std::move(newIndex));
+            index.AtomicSet(newIndexPtr);
+            if (!snapshotPath.empty()) {
+                SaveIndexSnapshot(*newIndexPtr, snapshotPath);
+            }
 
             if (firstRun) {
                 initContoller();
@@ -2,22 +2,48 @@
 
 #include "util.h"
 
-TServerClustering::TServerClustering(std::unique_ptr<TClusterer> clusterer, rocksdb::DB* db)
+TServerClustering::TServerClustering(
+    std::unique_ptr<TClusterer> clusterer,
+    rocksdb::DB* db,
+    const TDocumentTimeIndex* timeIndex,
+    std::vector<uint64_t> rankedPeriods,
+    std::string segmentPath
+)
     : Clusterer(std::move(clusterer))
     , Db(db)
+    , TimeIndex(timeIndex)
+    , RankedPeriods(std::move(rankedPeriods))
+    , SegmentPath(std::move(segmentPath))
 {
+    if (!SegmentPath.empty()) {
+        Segment = TDocumentSegment::Open(SegmentPath);
+    }
 }
 
 namespace {
 
-    std::pair<std::vector<TDbDocument>, uint64_t> ReadDocs(rocksdb::DB* db) {
+    struct TReadDocsResult {
+        std::vector<TDbDocument> Docs;
+        uint64_t Timestamp = 0;
+        // False if the segment already holds exactly the documents that were read
+        bool IsSegmentChanged = true;
+    };
+
+    // Documents with the same DB value as in the segment are taken from it without protobuf decoding,
+    // the others are decoded straight from the iterator
+    TReadDocsResult ReadDocs(
+        rocksdb::DB* db,
+        const TDocumentSegment* segment,
+        TDocumentSegmentWriter* segmentWriter)
+    {
         rocksdb::ManagedSnapshot snapshot(db);
 
         rocksdb::ReadOptions ropt(/*cksum*/ true, /*cache*/ true);
         ropt.snapshot = snapshot.snapshot();
 
-        std::vector<TDbDocument> docs;
-        uint64_t timestamp = 0;
+        TReadDocsResult result;
+        size_t segmentHits = 0;
+        bool hasNewRows = false;
 
         std::unique_ptr<rocksdb::Iterator> iter(db->NewIterator(ropt));
         for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
@@ -26,43 +52,63 @@ namespace {
                 continue;
             }
 
+            const std::string_view key(iter->key().data(), iter->key().size());
+            const uint64_t valueHash = CalcFnvHash(std::string_view(value.data(), value.size()));
+            const std::optional<size_t> row = segment ? segment->Find(key) : std::nullopt;
+            const bool isHit = row && segment->GetValueHash(row.value()) == valueHash;
+
             TDbDocument doc;
-            const bool succes = TDbDocument::ParseFromArray(value.data(), value.size(), &doc);
-            if (!succes) {
-                LOG_DEBUG("Bad document in db: " << iter->key().ToString());
+            if (isHit) {
+                doc = segment->GetDocument(row.value());
+                segmentHits++;
+            } else if (!TDbDocument::ParseFromArray(value.data(), value.size(), &doc)) {
+                LOG_DEBUG("Bad document in db: " << key);
                 continue;
             }
-
-            timestamp = std::max(timestamp, doc.FetchTime);
-            docs.push_back(std::move(doc));
+            if (segmentWriter && segmentWriter->Add(key, valueHash, doc) && !isHit) {
+                hasNewRows = true;
+            }
+            result.Timestamp = std::max(result.Timestamp, doc.FetchTime);
+            result.Docs.push_back(std::move(doc));
         }
 
-        return std::make_pair(std::move(docs), timestamp);
+        result.IsSegmentChanged = !segment || hasNewRows || segmentHits != segment->Size();
+        return result;
     }
 
-    void RemoveStaleDocs(rocksdb::DB* db, std::vector<TDbDocument>& docs, uint64_t timestamp) {
-        rocksdb::WriteOptions wopt;
-        for (const auto& doc : docs) {
-            if (doc.IsStale(timestamp)) {
-                db->Delete(wopt, doc.FileName);
-                LOG_DEBUG("Removed: " << doc.FileName);
-            }
-        }
+    // Stale documents are deleted from the DB by expired buckets of the time index
+    void RemoveStaleDocs(const TDocumentTimeIndex* timeIndex, std::vector<TDbDocument>& docs, uint64_t timestamp) {
+        const size_t removedCount = timeIndex->RemoveExpired(timestamp);
+        LOG_DEBUG("Removed " << removedCount << " expired docs");
         docs.erase(std::remove_if(docs.begin(), docs.end(), [timestamp] (const auto& doc) { return doc.IsStale(timestamp); }), docs.end());
     }
 
 }
 
-TClusterIndex TServerClustering::MakeIndex() const {
-    auto [docs, timestamp] = ReadDocs(Db);
+TClusterIndex TServerClustering::MakeIndex() {
+    std::optional<TDocumentSegmentWriter> segmentWriter;
+    if (!SegmentPath.empty()) {
+        segmentWriter.emplace();
+    }
+    auto [docs, timestamp, isSegmentChanged] = ReadDocs(Db, Segment.get(), segmentWriter ? &segmentWriter.value() : nullptr);
+    if (segmentWriter && isSegmentChanged && segmentWriter->Write(SegmentPath)) {
+        // The old mapping stays valid until it is replaced here
+        Segment = TDocumentSegment::Open(SegmentPath);
+    }
     LOG_DEBUG("Read " << docs.size() << " docs; timestamp: " << timestamp);
-    RemoveStaleDocs(Db, docs, timestamp);
-
-    TClusterIndex index = Clusterer->Cluster(std::move(docs));
+    RemoveStaleDocs(TimeIndex, docs, timestamp);
 
+    TClusterIndex index = Clusterer->Cluster(std::move(docs), TP_BACKGROUND);
     for (const auto& [lang, clusters] : index.Clusters) {
         LOG_DEBUG("Clustering output: " << ToString(lang) << " " << clusters.size() << " clusters");
     }
+    AddRankedViews(index);
 
     return index;
 };
+
+void TServerClustering::AddRankedViews(TClusterIndex& index) const {
+    for (const auto& [lang, clusters] : index.Clusters) {
+        index.RankedViews[lang] = BuildRankedViews(clusters, index.TrueMaxTimestamp, index.IterTimestamp, RankedPeriods, MAX_THREADS_COUNT);
+    }
+}
@@ -1,16 +1,32 @@
 #pragma once
 
 #include "clusterer.h"
+#include "document_segment.h"
+#include "time_index.h"
 
 #include <rocksdb/db.h>
 
+#include <vector>
+
 class TServerClustering {
 public:
-    TServerClustering(std::unique_ptr<TClusterer> clusterer, rocksdb::DB* db);
+    TServerClustering(
+        std::unique_ptr<TClusterer> clusterer,
+        rocksdb::DB* db,
+        const TDocumentTimeIndex* timeIndex,
+        std::vector<uint64_t> rankedPeriods = {},
+        std::string segmentPath = "");
 
-    TClusterIndex MakeIndex() const;
+    TClusterIndex MakeIndex();
+    void AddRankedViews(TClusterIndex& index) const;
 
 private:
     const std::unique_ptr<TClusterer> Clusterer;
     rocksdb::DB* Db;
+    const TDocumentTimeIndex* TimeIndex;
+    const std::vector<uint64_t> RankedPeriods;
+
+    // Clustering columns of the documents read last time, empty path to disable
+    const std::string SegmentPath;
+    std::unique_ptr<TDocumentSegment> Segment;
 };
@@ -1,59 +1,166 @@
-// Based on https://github.com/progschj/ThreadPool, altered to the project code style.
-//
-// Copyright (c) 2012 Jakob Progsch, Václav Zeman
-//
-// This software is provided 'as-is', without any express or implied
-// warranty. In no event will the authors be held liable for any damages
-// arising from the use of this software.
-
-// Permission is granted to anyone to use this software for any purpose,
-// including commercial applications, and to alter it and redistribute it
-// freely, subject to the following restrictions:
-
-// 1. The origin of this software must not be misrepresented; you must not
-// claim that you wrote the original software. If you use this software
-// in a product, an acknowledgment in the product documentation would be
-// appreciated but is not required.
-
-// 2. Altered source versions must be plainly marked as such, and must not be
-// misrepresented as being the original software.
-//
-// 3. This notice may not be removed or altered from any source
-// distribution.
-
 #include "thread_pool.h"
 
+#include <stdexcept>
 
-TThreadPool::TThreadPool(size_t threadsCount) {
-    for (size_t i = 0;i < threadsCount; ++i) {
-        Threads.emplace_back(
-            [this] {
-                while(true) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(Mutex);
-                        Condition.wait(lock, [this]{ return this->IsDone || !this->Tasks.empty(); });
-                        if (IsDone && Tasks.empty()) {
-                            return;
-                        }
-                        task = std::move(Tasks.front());
-                        Tasks.pop();
-                    }
-                    task();
-                }
-            }
-        );
+namespace {
+
+    // Pool and deque of the current worker thread
+    thread_local const TThreadPool* CurrentPool = nullptr;
+    thread_local size_t CurrentQueue = 0;
+
+}
+
+TTask::TTask(TTask&& other) noexcept {
+    if (other.Ops) {
+        other.Ops->Relocate(&Storage, &other.Storage);
+        Ops = std::exchange(other.Ops, nullptr);
+    }
+}
+
+TTask& TTask::operator=(TTask&& other) noexcept {
+    if (this != &other) {
+        if (Ops) {
+            Ops->Destroy(&Storage);
+            Ops = nullptr;
+        }
+        if (other.Ops) {
+            other.Ops->Relocate(&Storage, &other.Storage);
+            Ops = std::exchange(other.Ops, nullptr);
+        }
+    }
+    return *this;
+}
+
+TTask::~TTask() {
+    if (Ops) {
+        Ops->Destroy(&Storage);
+    }
+}
+
+TThreadPool::TThreadPool(size_t threadsCount, size_t interactiveThreadsCount) {
+    threadsCount = std::max<size_t>(threadsCount, 1);
+    // At least one worker runs every lane
+    InteractiveThreadsCount = std::min(interactiveThreadsCount, threadsCount - 1);
+    for (size_t i = 0; i < threadsCount; ++i) {
+        Queues.push_back(std::make_unique<TWorkerQueue>());
     }
+    for (size_t i = 0; i < threadsCount; ++i) {
+        Threads.emplace_back([this, i] { RunWorker(i); });
+    }
+}
+
+TThreadPool& TThreadPool::Get() {
+    static TThreadPool pool(std::thread::hardware_concurrency(), /* interactiveThreadsCount */ 1);
+    return pool;
 }
 
 TThreadPool::~TThreadPool() {
     {
-        std::unique_lock<std::mutex> lock(Mutex);
+        std::unique_lock<std::mutex> lock(SleepMutex);
         IsDone = true;
     }
-    Condition.notify_all();
-    for(auto&& thread : Threads) {
+    WakeUp.notify_all();
+    InteractiveWakeUp.notify_all();
+    for (auto&& thread : Threads) {
         thread.join();
     }
 }
 
+void TThreadPool::Push(TTask&& task, ETaskPriority priority) {
+    const bool isWorker = CurrentPool == this;
+    // Workers still finish their tasks while the pool is stopping
+    if (IsDone && !isWorker) {
+        throw std::runtime_error("enqueue on stopped TThreadPool");
+    }
+    const size_t index = isWorker ? CurrentQueue : NextQueue.fetch_add(1, std::memory_order_relaxed) % Queues.size();
+    {
+        std::lock_guard<std::mutex> lock(Queues[index]->Mutex);
+        Queues[index]->Tasks[priority].push_back(std::move(task));
+        ++PendingCounts[priority];
+    }
+    // A worker going to sleep increments SleepersCount before it checks PendingCounts
+    if (SleepersCount > 0) {
+        std::lock_guard<std::mutex> lock(SleepMutex);
+        WakeUp.notify_one();
+        if (priority == TP_INTERACTIVE) {
+            InteractiveWakeUp.notify_one();
+        }
+    }
+}
+
+bool TThreadPool::TryPop(size_t start, bool isOwner, ETaskPriority maxPriority, TTask& task) {
+    for (size_t priority = 0; priority <= maxPriority; ++priority) {
+        if (PendingCounts[priority] == 0) {
+            continue;
+        }
+        for (size_t i = 0; i < Queues.size(); ++i) {
+            TWorkerQueue& queue = *Queues[(start + i) % Queues.size()];
+            std::lock_guard<std::mutex> lock(queue.Mutex);
+            std::deque<TTask>& tasks = queue.Tasks[priority];
+            if (tasks.empty()) {
+                continue;
+            }
+            // The owner takes its newest task, thieves take the oldest one
+            if (isOwner && i == 0) {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+            } else {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            --PendingCounts[priority];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TThreadPool::HasPending(ETaskPriority maxPriority) const {
+    for (size_t priority = 0; priority <= maxPriority; ++priority) {
+        if (PendingCounts[priority] > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ETaskPriority TThreadPool::GetMaxPriority(size_t worker) const {
+    return worker < InteractiveThreadsCount ? TP_INTERACTIVE : TP_BULK;
+}
+
+void TThreadPool::RunWorker(size_t index) {
+    CurrentPool = this;
+    CurrentQueue = index;
+    const ETaskPriority maxPriority = GetMaxPriority(index);
+    std::condition_variable& wakeUp = maxPriority == TP_INTERACTIVE ? InteractiveWakeUp : WakeUp;
+    while (true) {
+        TTask task;
+        if (TryPop(index, /* isOwner */ true, maxPriority, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(SleepMutex);
+        ++SleepersCount;
+        wakeUp.wait(lock, [this, maxPriority] { return IsDone || HasPending(maxPriority); });
+        --SleepersCount;
+        if (IsDone && !HasPending(maxPriority)) {
+            return;
+        }
+    }
+}
+
+void TThreadPool::Wait(TParallelForState& state) {
+    // Help with queued tasks instead of blocking a thread
+    const bool isWorker = CurrentPool == this;
+    const size_t start = isWorker ? CurrentQueue : 0;
+    const ETaskPriority maxPriority = isWorker ? GetMaxPriority(CurrentQueue) : TP_BULK;
+    while (state.Remaining > 0) {
+        TTask task;
+        if (!TryPop(start, isWorker, maxPriority, task)) {
+            break;
+        }
+        task();
+    }
+    std::unique_lock<std::mutex> lock(state.Mutex);
+    state.Done.wait(lock, [&state] { return state.Remaining == 0; });
+}
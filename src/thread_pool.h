@@ -1,84 +1,295 @@
-// Based on https://github.com/progschj/ThreadPool, altered to the project code style.
-//
-// Copyright (c) 2012 Jakob Progsch, Václav Zeman
-//
-// This software is provided 'as-is', without any express or implied
-// warranty. In no event will the authors be held liable for any damages
-// arising from the use of this software.
-
-// Permission is granted to anyone to use this software for any purpose,
-// including commercial applications, and to alter it and redistribute it
-// freely, subject to the following restrictions:
-
-// 1. The origin of this software must not be misrepresented; you must not
-// claim that you wrote the original software. If you use this software
-// in a product, an acknowledgment in the product documentation would be
-// appreciated but is not required.
-
-// 2. Altered source versions must be plainly marked as such, and must not be
-// misrepresented as being the original software.
-//
-// 3. This notice may not be removed or altered from any source
-// distribution.
-
 #pragma once
 
-#include <vector>
-#include <queue>
-#include <memory>
-#include <thread>
-#include <mutex>
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
-#include <future>
+#include <cstddef>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Move-only void() callable. Closures up to INLINE_SIZE bytes are stored inline,
+// larger ones are heap allocated.
+class TTask {
+public:
+    TTask() = default;
+
+    template <class F, class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, TTask>>>
+    TTask(F&& f);
+
+    TTask(TTask&& other) noexcept;
+    TTask& operator=(TTask&& other) noexcept;
+    TTask(const TTask&) = delete;
+    TTask& operator=(const TTask&) = delete;
+    ~TTask();
+
+    explicit operator bool() const {
+        return Ops != nullptr;
+    }
 
+    void operator()() {
+        Ops->Invoke(&Storage);
+    }
+
+private:
+    static constexpr size_t INLINE_SIZE = 48;
+
+    struct TOps {
+        void (*Invoke)(void* storage);
+        // Move constructs the callable into dst and destroys the one in src
+        void (*Relocate)(void* dst, void* src);
+        void (*Destroy)(void* storage);
+    };
+
+    template <class F>
+    static constexpr bool IsInline = sizeof(F) <= INLINE_SIZE
+        && alignof(F) <= alignof(std::max_align_t)
+        && std::is_nothrow_move_constructible_v<F>;
+
+    template <class F>
+    static const TOps* GetOps();
+
+private:
+    std::aligned_storage_t<INLINE_SIZE, alignof(std::max_align_t)> Storage;
+    const TOps* Ops = nullptr;
+};
+
+// Lanes of the thread pool. A free worker always takes a task of the most urgent lane.
+enum ETaskPriority {
+    TP_INTERACTIVE = 0, // request handling, e.g. PUT annotation in the server
+    TP_BACKGROUND = 1, // periodic server clustering
+    TP_BULK = 2, // CLI annotation and clustering
+    TP_COUNT = 3
+};
+
+// Work-stealing thread pool. Every worker owns a deque per lane: it pushes and pops its own tasks
+// at the back and steals from the front of the others. Tasks submitted from outside
+// the pool are spread over the deques round-robin.
 class TThreadPool {
 public:
-    // The constructor just launches some amount of workers
-    TThreadPool(size_t threadsCount=std::thread::hardware_concurrency());
+    // The first interactiveThreadsCount workers run only TP_INTERACTIVE tasks,
+    // so other lanes can never occupy all the threads
+    TThreadPool(size_t threadsCount=std::thread::hardware_concurrency(), size_t interactiveThreadsCount=0);
 
-    // Add new work item to the pool
+    // Process-wide pool shared by annotation, clustering and request handling,
+    // one thread is reserved for TP_INTERACTIVE tasks on multicore machines
+    static TThreadPool& Get();
+
+    // Add new work item to the pool, TP_BULK lane unless priority is given
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
 
-    // The destructor joins all threads
+    template<class F, class... Args>
+    auto enqueue(ETaskPriority priority, F&& f, Args&&... args)
+        -> std::future<typename std::result_of<F(Args...)>::type>;
+
+    // Calls f(i) for every i in [begin, end), split into chunks of grainSize indices run in the priority lane.
+    // With grainSize 0 chunks are adaptive: every thread takes a share of the remaining
+    // indices, so chunks start large and shrink towards the end of the range.
+    // Returns when all calls are done, the calling thread runs chunks too, so nested calls
+    // from pool tasks do not deadlock. The first exception thrown by f is rethrown.
+    template <class F>
+    void parallel_for(size_t begin, size_t end, F&& f, size_t grainSize = 0, ETaskPriority priority = TP_BULK);
+
+    // Stores f(*it) for every it in [begin, end) to output, which must already have
+    // room for end - begin values. Chunks are the same as in parallel_for.
+    template <class TInputIterator, class TOutputIterator, class F>
+    void parallel_map(TInputIterator begin, TInputIterator end, TOutputIterator output, F&& f, size_t grainSize = 0, ETaskPriority priority = TP_BULK);
+
+    size_t GetThreadsCount() const {
+        return Threads.size();
+    }
+
+    // The destructor runs the remaining tasks and joins all threads
     ~TThreadPool();
 
 private:
-    // Need to keep track of threads so we can join them
+    struct alignas(64) TWorkerQueue {
+        std::mutex Mutex;
+        std::deque<TTask> Tasks[TP_COUNT];
+    };
+
+    struct TParallelForState {
+        std::atomic<size_t> Remaining = 0;
+        std::mutex Mutex;
+        std::condition_variable Done;
+        std::exception_ptr Error;
+    };
+
+    void Push(TTask&& task, ETaskPriority priority);
+    // Takes a task of the most urgent lane up to maxPriority
+    bool TryPop(size_t start, bool isOwner, ETaskPriority maxPriority, TTask& task);
+    bool HasPending(ETaskPriority maxPriority) const;
+    ETaskPriority GetMaxPriority(size_t worker) const;
+    void RunWorker(size_t index);
+    void Wait(TParallelForState& state);
+
+    // parallel_for with chunks of exactly grainSize indices
+    template <class F>
+    void RunChunks(size_t begin, size_t end, F&& f, size_t grainSize, ETaskPriority priority);
+
+private:
+    std::vector<std::unique_ptr<TWorkerQueue>> Queues;
     std::vector<std::thread> Threads;
-    // The task queue
-    std::queue<std::function<void()>> Tasks;
 
-    // Synchronization
-    std::mutex Mutex;
-    std::condition_variable Condition;
-    bool IsDone = false;
+    size_t InteractiveThreadsCount = 0;
+
+    // Tasks of every lane in the queues, changed under the queue mutex
+    std::atomic<size_t> PendingCounts[TP_COUNT] = {};
+    std::atomic<size_t> NextQueue = 0;
+
+    // Synchronization of idle workers, interactive workers sleep on their own variable
+    std::mutex SleepMutex;
+    std::condition_variable WakeUp;
+    std::condition_variable InteractiveWakeUp;
+    std::atomic<size_t> SleepersCount = 0;
+    std::atomic<bool> IsDone = false;
 };
 
+template <class F>
+const TTask::TOps* TTask::GetOps() {
+    if constexpr (IsInline<F>) {
+        static constexpr TOps ops = {
+            [](void* storage) {
+                (*static_cast<F*>(storage))();
+            },
+            [](void* dst, void* src) {
+                F* func = static_cast<F*>(src);
+                new (dst) F(std::move(*func));
+                func->~F();
+            },
+            [](void* storage) {
+                static_cast<F*>(storage)->~F();
+            }
+        };
+        return &ops;
+    } else {
+        static constexpr TOps ops = {
+            [](void* storage) {
+                (**static_cast<F**>(storage))();
+            },
+            [](void* dst, void* src) {
+                *static_cast<F**>(dst) = *static_cast<F**>(src);
+            },
+            [](void* storage) {
+                delete *static_cast<F**>(storage);
+            }
+        };
+        return &ops;
+    }
+}
+
+template <class F, class>
+TTask::TTask(F&& f) {
+    using TFunc = std::decay_t<F>;
+    if constexpr (IsInline<TFunc>) {
+        new (&Storage) TFunc(std::forward<F>(f));
+    } else {
+        *reinterpret_cast<TFunc**>(&Storage) = new TFunc(std::forward<F>(f));
+    }
+    Ops = GetOps<TFunc>();
+}
+
 template<class F, class... Args>
 auto TThreadPool::enqueue(F&& f, Args&&... args)
     -> std::future<typename std::result_of<F(Args...)>::type>
+{
+    return enqueue(TP_BULK, std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template<class F, class... Args>
+auto TThreadPool::enqueue(ETaskPriority priority, F&& f, Args&&... args)
+    -> std::future<typename std::result_of<F(Args...)>::type>
 {
     using return_type = typename std::result_of<F(Args...)>::type;
 
-    auto task = std::make_shared< std::packaged_task<return_type()> >(
+    // The bound call lives in the packaged_task state, the task itself fits into TTask
+    std::packaged_task<return_type()> task(
         std::bind(std::forward<F>(f), std::forward<Args>(args)...)
     );
+    std::future<return_type> res = task.get_future();
+    Push(TTask(std::move(task)), priority);
+    return res;
+}
+
+template <class F>
+void TThreadPool::parallel_for(size_t begin, size_t end, F&& f, size_t grainSize, ETaskPriority priority) {
+    if (begin >= end) {
+        return;
+    }
+    const size_t size = end - begin;
+    if (grainSize == 0) {
+        // Guided scheduling: every participant takes 1 / (2 * participantsCount) of the rest
+        const size_t participantsCount = std::min(size, Threads.size() + 1);
+        std::atomic<size_t> next = begin;
+        RunChunks(0, participantsCount, [&f, &next, end, participantsCount](size_t) {
+            size_t chunkBegin = next.load();
+            while (chunkBegin < end) {
+                const size_t chunkSize = std::max<size_t>((end - chunkBegin) / (2 * participantsCount), 1);
+                if (!next.compare_exchange_weak(chunkBegin, chunkBegin + chunkSize)) {
+                    continue;
+                }
+                for (size_t i = chunkBegin; i < chunkBegin + chunkSize; ++i) {
+                    f(i);
+                }
+                chunkBegin = next.load();
+            }
+        }, 1, priority);
+    } else {
+        RunChunks(begin, end, f, grainSize, priority);
+    }
+}
 
-    std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(Mutex);
+template <class F>
+void TThreadPool::RunChunks(size_t begin, size_t end, F&& f, size_t grainSize, ETaskPriority priority) {
+    const size_t chunksCount = (end - begin + grainSize - 1) / grainSize;
 
-        // Don't allow enqueueing after stopping the pool
-        if (IsDone) {
-            throw std::runtime_error("enqueue on stopped TThreadPool");
+    TParallelForState state;
+    state.Remaining = chunksCount;
+    const auto runChunk = [&f, &state](size_t chunkBegin, size_t chunkEnd) {
+        try {
+            for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+                f(i);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(state.Mutex);
+            if (!state.Error) {
+                state.Error = std::current_exception();
+            }
         }
-
-        Tasks.emplace([task](){ (*task)(); });
+        // Under the mutex, so that state outlives the notification
+        std::lock_guard<std::mutex> lock(state.Mutex);
+        if (state.Remaining.fetch_sub(1) == 1) {
+            state.Done.notify_all();
+        }
+    };
+    for (size_t chunk = 1; chunk < chunksCount; ++chunk) {
+        const size_t chunkBegin = begin + chunk * grainSize;
+        const size_t chunkEnd = std::min(end, chunkBegin + grainSize);
+        Push(TTask([&runChunk, chunkBegin, chunkEnd] {
+            runChunk(chunkBegin, chunkEnd);
+        }), priority);
+    }
+    runChunk(begin, std::min(end, begin + grainSize));
+    Wait(state);
+    if (state.Error) {
+        std::rethrow_exception(state.Error);
     }
-    Condition.notify_one();
-    return res;
 }
 
+template <class TInputIterator, class TOutputIterator, class F>
+void TThreadPool::parallel_map(TInputIterator begin, TInputIterator end, TOutputIterator output, F&& f, size_t grainSize, ETaskPriority priority) {
+    parallel_for(0, std::distance(begin, end), [begin, output, &f](size_t i) {
+        output[i] = f(begin[i]);
+    }, grainSize, priority);
+}
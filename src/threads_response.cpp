@@ -0,0 +1,118 @@
+#include "threads_response.h"
+
+#include "util.h"
+
+#include <cstdio>
+#include <string_view>
+#include <zlib.h>
+
+namespace {
+
+    void AppendJsonString(std::string& output, std::string_view value) {
+        output += '"';
+        for (const char c : value) {
+            switch (c) {
+                case '"': output += "\\\""; break;
+                case '\\': output += "\\\\"; break;
+                case '\b': output += "\\b"; break;
+                case '\f': output += "\\f"; break;
+                case '\n': output += "\\n"; break;
+                case '\r': output += "\\r"; break;
+                case '\t': output += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+                        output += escaped;
+                    } else {
+                        output += c;
+                    }
+            }
+        }
+        output += '"';
+    }
+
+    std::string GzipCompress(const std::string& data) {
+        z_stream stream{};
+        // 16 + MAX_WBITS selects the gzip wrapper
+        ENSURE(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK, "deflateInit2 failed");
+        std::string compressed(deflateBound(&stream, data.size()), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        stream.avail_in = data.size();
+        stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+        stream.avail_out = compressed.size();
+        const int result = deflate(&stream, Z_FINISH);
+        compressed.resize(stream.total_out);
+        deflateEnd(&stream);
+        ENSURE(result == Z_STREAM_END, "deflate failed");
+        return compressed;
+    }
+
+}
+
+std::string MakeThreadsJson(const std::vector<TWeightedNewsCluster>& clusters) {
+    // Same keys and key order as the jsoncpp output
+    std::string json = "{\"threads\":[";
+    for (size_t i = 0; i < clusters.size(); ++i) {
+        const TNewsCluster& cluster = clusters[i].Cluster.get();
+        json += (i == 0) ? "{\"articles\":[" : ",{\"articles\":[";
+        const auto& documents = cluster.GetDocuments();
+        for (size_t j = 0; j < documents.size(); ++j) {
+            if (j != 0) {
+                json += ',';
+            }
+            AppendJsonString(json, documents[j].get().FileName);
+        }
+        json += "],\"category\":";
+        AppendJsonString(json, ToString(cluster.GetCategory()));
+        json += ",\"title\":";
+        AppendJsonString(json, cluster.GetTitle());
+        json += '}';
+    }
+    json += "]}";
+    return json;
+}
+
+namespace {
+
+    drogon::HttpResponsePtr MakeNotModified(const std::string& etag) {
+        auto response = drogon::HttpResponse::newHttpResponse();
+        response->setStatusCode(drogon::k304NotModified);
+        response->addHeader("ETag", etag);
+        response->addHeader("Vary", "Accept-Encoding");
+        response->setExpiredTime(0);
+        return response;
+    }
+
+}
+
+TThreadsResponseCache::TThreadsResponseCache(uint64_t generation, const std::string& tag)
+    : Generation(generation)
+    , ETag("\"" + tag + "\"")
+    , GzipETag("\"" + tag + "-gz\"")
+    , NotModified(MakeNotModified(ETag))
+    , GzipNotModified(MakeNotModified(GzipETag))
+{
+}
+
+bool TThreadsResponseCache::IsNotModified(const std::string& ifNoneMatch) const {
+    // ETags are quoted, so one can't match inside the other
+    return !ifNoneMatch.empty() && (ifNoneMatch == "*"
+        || ifNoneMatch.find(ETag) != std::string::npos
+        || ifNoneMatch.find(GzipETag) != std::string::npos);
+}
+
+drogon::HttpResponsePtr TThreadsResponseCache::MakeResponse(std::string body, bool gzip) const {
+    auto response = drogon::HttpResponse::newHttpResponse();
+    response->setContentTypeCode(drogon::CT_APPLICATION_JSON);
+    response->addHeader("ETag", GetETag(gzip));
+    response->addHeader("Vary", "Accept-Encoding");
+    if (gzip) {
+        response->addHeader("Content-Encoding", "gzip");
+        body = GzipCompress(body);
+    }
+    response->setBody(std::move(body));
+    // Non-negative expiration time makes drogon render the response once and reuse the bytes
+    response->setExpiredTime(0);
+    return response;
+}
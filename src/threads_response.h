@@ -0,0 +1,68 @@
+#pragma once
+
+#include "rank.h"
+
+#include <drogon/HttpController.h>
+
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// /threads response body, written directly without a JSON tree
+std::string MakeThreadsJson(const std::vector<TWeightedNewsCluster>& clusters);
+
+// Ready-to-send /threads responses for one generation of the cluster index
+class TThreadsResponseCache {
+public:
+    // Strong ETags differ per representation: "<tag>" for identity bodies, "<tag>-gz" for gzip ones
+    TThreadsResponseCache(uint64_t generation, const std::string& tag);
+
+    uint64_t GetGeneration() const { return Generation; }
+    const std::string& GetETag(bool gzip) const { return gzip ? GzipETag : ETag; }
+    // Both representations have the same content, so either ETag matches
+    bool IsNotModified(const std::string& ifNoneMatch) const;
+    const drogon::HttpResponsePtr& GetNotModified(bool gzip) const { return gzip ? GzipNotModified : NotModified; }
+
+    // Cached response, makeBody is called for the first request with these arguments only
+    template <class TMakeBody>
+    drogon::HttpResponsePtr Get(tg::ELanguage lang, tg::ECategory category, uint64_t period, bool gzip, TMakeBody&& makeBody);
+
+    // Uncached response with the same headers as cached ones
+    drogon::HttpResponsePtr MakeResponse(std::string body, bool gzip) const;
+
+private:
+    using TKey = std::tuple<tg::ELanguage, tg::ECategory, uint64_t, bool>;
+
+    const uint64_t Generation;
+    const std::string ETag;
+    const std::string GzipETag;
+    drogon::HttpResponsePtr NotModified;
+    drogon::HttpResponsePtr GzipNotModified;
+
+    mutable std::shared_mutex Mutex;
+    std::map<TKey, drogon::HttpResponsePtr> Responses;
+};
+
+template <class TMakeBody>
+drogon::HttpResponsePtr TThreadsResponseCache::Get(
+    tg::ELanguage lang,
+    tg::ECategory category,
+    uint64_t period,
+    bool gzip,
+    TMakeBody&& makeBody)
+{
+    const TKey key(lang, category, period, gzip);
+    {
+        std::shared_lock<std::shared_mutex> lock(Mutex);
+        const auto it = Responses.find(key);
+        if (it != Responses.end()) {
+            return it->second;
+        }
+    }
+    // Concurrent first requests may build the same response twice, the first one is kept
+    drogon::HttpResponsePtr response = MakeResponse(makeBody(), gzip);
+    std::unique_lock<std::shared_mutex> lock(Mutex);
+    return Responses.try_emplace(key, std::move(response)).first->second;
+}
@@ -0,0 +1,99 @@
+#include "time_index.h"
+
+#include "util.h"
+
+#include <memory>
+
+namespace {
+
+    std::string MakeBucketKey(uint64_t bucket) {
+        std::string key(sizeof(bucket), '\0');
+        for (size_t i = 0; i < sizeof(bucket); ++i) {
+            key[i] = static_cast<char>((bucket >> (8 * (sizeof(bucket) - 1 - i))) & 0xFF);
+        }
+        return key;
+    }
+
+    // Bucket keys of real timestamps never get to this one
+    const std::string BUILT_MARKER_KEY = std::string(sizeof(uint64_t), '\xFF') + "built";
+
+    uint64_t GetExpirationTime(const TDbDocument& document) {
+        return document.FetchTime + document.Ttl;
+    }
+
+}
+
+TDocumentTimeIndex::TDocumentTimeIndex(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* handle)
+    : Db(db)
+    , Handle(handle)
+{
+}
+
+TDocumentTimeIndex::~TDocumentTimeIndex() {
+    Db->DestroyColumnFamilyHandle(Handle);
+}
+
+void TDocumentTimeIndex::Add(rocksdb::WriteBatch* batch, const std::string& fname, const TDbDocument& document) const {
+    batch->Put(Handle, MakeBucketKey(GetExpirationTime(document) / BUCKET_SIZE) + fname, rocksdb::Slice());
+}
+
+bool TDocumentTimeIndex::IsBuilt() const {
+    std::string value;
+    const rocksdb::Status s = Db->Get(rocksdb::ReadOptions(), Handle, BUILT_MARKER_KEY, &value);
+    ENSURE(s.ok() || s.IsNotFound(), "Failed to read time index: " << s.ToString());
+    return s.ok();
+}
+
+void TDocumentTimeIndex::Rebuild() const {
+    rocksdb::WriteBatch batch;
+    size_t count = 0;
+    std::unique_ptr<rocksdb::Iterator> iter(Db->NewIterator(rocksdb::ReadOptions()));
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        const rocksdb::Slice value = iter->value();
+        TDbDocument document;
+        if (value.empty() || !TDbDocument::ParseFromArray(value.data(), value.size(), &document)) {
+            continue;
+        }
+        Add(&batch, iter->key().ToString(), document);
+        ++count;
+    }
+    // Written atomically with the entries, so an interrupted rebuild is run again on the next start
+    batch.Put(Handle, BUILT_MARKER_KEY, rocksdb::Slice());
+    const rocksdb::Status s = Db->Write(rocksdb::WriteOptions(), &batch);
+    ENSURE(s.ok(), "Failed to build time index: " << s.ToString());
+    LOG_DEBUG("Time index: " << count << " documents indexed");
+}
+
+size_t TDocumentTimeIndex::RemoveExpired(uint64_t timestamp) const {
+    // Every expiration time of a bucket before endBucket is smaller than timestamp
+    const std::string endKey = MakeBucketKey(timestamp / BUCKET_SIZE);
+    const rocksdb::Slice upperBound(endKey);
+    rocksdb::ReadOptions ropt;
+    ropt.iterate_upper_bound = &upperBound;
+
+    rocksdb::WriteBatch batch;
+    size_t count = 0;
+    std::unique_ptr<rocksdb::Iterator> iter(Db->NewIterator(ropt, Handle));
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        const rocksdb::Slice key = iter->key();
+        const std::string fname(key.data() + sizeof(uint64_t), key.size() - sizeof(uint64_t));
+        std::string value;
+        if (!Db->Get(rocksdb::ReadOptions(), fname, &value).ok() || value.empty()) {
+            continue;
+        }
+        // The document may have been put again since, then it has a newer entry
+        TDbDocument document;
+        if (TDbDocument::ParseFromArray(value.data(), value.size(), &document) && document.IsStale(timestamp)) {
+            batch.Delete(fname);
+            LOG_DEBUG("Removed: " << fname);
+            ++count;
+        }
+    }
+    batch.DeleteRange(Handle, MakeBucketKey(0), endKey);
+    const rocksdb::Status s = Db->Write(rocksdb::WriteOptions(), &batch);
+    if (!s.ok()) {
+        LOG_ERROR("Failed to remove expired documents: " << s.ToString());
+        return 0;
+    }
+    return count;
+}
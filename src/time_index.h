@@ -0,0 +1,35 @@
+#pragma once
+
+#include "db_document.h"
+
+#include <rocksdb/db.h>
+#include <rocksdb/write_batch.h>
+
+#include <string>
+
+// Secondary index of DB documents by expiration time.
+// Keys are (big-endian expiration bucket, fname) in a separate column family, values are empty.
+// The column family also has a marker key after all buckets, written together with Rebuild results.
+class TDocumentTimeIndex {
+public:
+    static constexpr const char* COLUMN_FAMILY = "time_index";
+    static constexpr uint64_t BUCKET_SIZE = 3600;
+
+    // Takes ownership of the column family handle
+    TDocumentTimeIndex(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* handle);
+    ~TDocumentTimeIndex();
+
+    // Adds the index entry of a document to the batch with its Put
+    void Add(rocksdb::WriteBatch* batch, const std::string& fname, const TDbDocument& document) const;
+    // False until Rebuild has completed, e.g. for databases created before the index
+    bool IsBuilt() const;
+    // Indexes every stored document
+    void Rebuild() const;
+    // Deletes the documents of buckets that expired before timestamp, then drops these buckets.
+    // Only these candidates are decoded. Returns the number of deleted documents.
+    size_t RemoveExpired(uint64_t timestamp) const;
+
+private:
+    rocksdb::DB* Db;
+    rocksdb::ColumnFamilyHandle* Handle;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cassert>
+#include <string_view>
+#include <vector>
+
+// Non-owning view over a contiguous run of tokens
+class TTokenSpan {
+public:
+    TTokenSpan() = default;
+    TTokenSpan(const std::string_view* begin, const std::string_view* end)
+        : Begin(begin)
+        , End(end)
+    {
+    }
+    TTokenSpan(const std::vector<std::string_view>& tokens)
+        : Begin(tokens.data())
+        , End(tokens.data() + tokens.size())
+    {
+    }
+
+    const std::string_view* begin() const { return Begin; }
+    const std::string_view* end() const { return End; }
+    size_t size() const { return End - Begin; }
+    bool empty() const { return Begin == End; }
+
+    const std::string_view& operator[](size_t i) const {
+        assert(i < size());
+        return Begin[i];
+    }
+
+private:
+    const std::string_view* Begin = nullptr;
+    const std::string_view* End = nullptr;
+};
@@ -0,0 +1,40 @@
+#include "tokenized_document.h"
+
+#include <onmt/Tokenizer.h>
+
+TTokenizedDocument::TTokenizedDocument(
+    const onmt::Tokenizer& tokenizer,
+    const std::string& title,
+    const std::string& text)
+{
+    std::vector<std::string> titleTokens;
+    std::vector<std::string> textTokens;
+    tokenizer.tokenize(title, titleTokens);
+    tokenizer.tokenize(text, textTokens);
+
+    size_t bufferSize = 0;
+    for (const auto* tokens : {&titleTokens, &textTokens}) {
+        for (const std::string& token : *tokens) {
+            bufferSize += token.size() + 1;
+        }
+    }
+    // No reallocations after this point, so views stay valid
+    Buffer.reserve(bufferSize);
+    Tokens.reserve(titleTokens.size() + textTokens.size());
+    for (const auto* tokens : {&titleTokens, &textTokens}) {
+        for (const std::string& token : *tokens) {
+            if (token.empty()) {
+                continue;
+            }
+            if (!Buffer.empty()) {
+                Buffer.push_back(' ');
+            }
+            const size_t offset = Buffer.size();
+            Buffer.append(token);
+            Tokens.emplace_back(Buffer.data() + offset, token.size());
+        }
+        if (tokens == &titleTokens) {
+            TitleSize = Tokens.size();
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "token_span.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace onmt {
+    class Tokenizer;
+}
+
+// Title and text tokens of a document, stored over one shared buffer.
+// Title tokens go first, so GetAll() covers "title text" without joining anything.
+// Tokens are views into the own buffer, hence the class is neither copyable nor movable.
+class TTokenizedDocument {
+public:
+    TTokenizedDocument(const onmt::Tokenizer& tokenizer, const std::string& title, const std::string& text);
+
+    TTokenizedDocument(const TTokenizedDocument&) = delete;
+    TTokenizedDocument& operator=(const TTokenizedDocument&) = delete;
+
+    TTokenSpan GetTitle() const { return {Tokens.data(), Tokens.data() + TitleSize}; }
+    TTokenSpan GetText() const { return {Tokens.data() + TitleSize, Tokens.data() + Tokens.size()}; }
+    TTokenSpan GetAll() const { return Tokens; }
+
+private:
+    std::string Buffer;
+    std::vector<std::string_view> Tokens;
+    size_t TitleSize = 0;
+};
@@ -1,27 +1,212 @@
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
 #include <ctime>
+#include <deque>
+#include <mutex>
 #include <regex>
 
-#include <boost/filesystem.hpp>
+#include <dirent.h>
+#include <sys/stat.h>
 
+#include "thread_pool.h"
 #include "util.h"
 
-void ReadFileNames(const std::string& directory, std::vector<std::string>& fileNames, int nDocs) {
-    boost::filesystem::path dirPath(directory);
-    boost::filesystem::recursive_directory_iterator start(dirPath);
-    boost::filesystem::recursive_directory_iterator end;
-    for (auto it = start; it != end; it++) {
-        if (boost::filesystem::is_directory(it->path())) {
-            continue;
+namespace {
+
+bool IsHtmlFileName(const char* name) {
+    const size_t length = std::strlen(name);
+    return length >= 5 && std::memcmp(name + length - 5, ".html", 5) == 0;
+}
+
+// Lists directories as TP_BULK tasks of the shared pool. Entries of every directory are sorted by name,
+// and file names are reported to a callback on the calling thread in DFS order,
+// listings of directories that are not reached yet are buffered.
+class TDirectoryWalker {
+public:
+    TDirectoryWalker(const std::function<void(std::string&&)>& onFile, int nDocs)
+        : OnFile(onFile)
+        , NDocs(nDocs)
+    {
+    }
+
+    void Run(const std::string& directory) {
+        TNode& root = Nodes.emplace_back();
+        root.Path = directory;
+        ENSURE(ListDirectory(root), "Can't open directory " << directory);
+        try {
+            Emit(root);
+        } catch (...) {
+            std::unique_lock<std::mutex> lock(Mutex);
+            if (!Error) {
+                Error = std::current_exception();
+            }
+            Stop();
+        }
+        {
+            // Listing is not needed any more if the walk is cut by NDocs,
+            // queued tasks still refer to the walker, so they are waited for
+            std::unique_lock<std::mutex> lock(Mutex);
+            Stop();
+            HasListing.wait(lock, [this] { return PendingCount == 0; });
+        }
+        if (Error) {
+            std::rethrow_exception(Error);
+        }
+    }
+
+private:
+    struct TNode;
+
+    struct TEntry {
+        std::string Name;
+        std::string Path;
+        bool IsDirectory = false;
+        // Set when the directory is queued for listing
+        TNode* Directory = nullptr;
+    };
+
+    struct TNode {
+        std::string Path;
+        bool IsListed = false;
+        std::vector<TEntry> Entries;
+    };
+
+    // Returns false when the walk is stopped
+    bool Emit(TNode& node) {
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            HasListing.wait(lock, [&node, this] { return node.IsListed || IsStopped; });
+            if (IsStopped) {
+                return false;
+            }
+        }
+        std::vector<TEntry> entries = std::move(node.Entries);
+        for (TEntry& entry : entries) {
+            if (entry.IsDirectory) {
+                if (!Emit(*entry.Directory)) {
+                    return false;
+                }
+                continue;
+            }
+            if (NDocs != -1 && FilesCount == static_cast<size_t>(NDocs)) {
+                return false;
+            }
+            ++FilesCount;
+            OnFile(std::move(entry.Path));
+        }
+        return true;
+    }
+
+    void ListTask(TNode& node) {
+        try {
+            if (!IsStopped && !ListDirectory(node)) {
+                LOG_DEBUG("Can't open directory " << node.Path);
+            }
+        } catch (...) {
+            std::unique_lock<std::mutex> lock(Mutex);
+            if (!Error) {
+                Error = std::current_exception();
+            }
+            Stop();
         }
-        std::string path = it->path().string();
-        if (path.substr(path.length() - 5) == ".html") {
-            fileNames.push_back(path);
+        std::unique_lock<std::mutex> lock(Mutex);
+        --PendingCount;
+        HasListing.notify_all();
+    }
+
+    // Requires Mutex
+    void Stop() {
+        IsStopped = true;
+        HasListing.notify_all();
+    }
+
+    // Publishes the sorted entries of the node, subdirectories are queued for listing.
+    // A directory that can't be opened is published empty.
+    bool ListDirectory(TNode& node) {
+        std::vector<TEntry> entries;
+        DIR* dir = opendir(node.Path.c_str());
+        if (dir) {
+            while (const dirent* entry = readdir(dir)) {
+                const char* name = entry->d_name;
+                if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0) {
+                    continue;
+                }
+                std::string path = node.Path + "/" + name;
+                // File types come from getdents, stat is called only for symlinks
+                // and for file systems that do not fill d_type
+                bool isDirectory = entry->d_type == DT_DIR;
+                bool isSymlink = entry->d_type == DT_LNK;
+                struct stat st;
+                if (entry->d_type == DT_UNKNOWN) {
+                    if (lstat(path.c_str(), &st) != 0) {
+                        continue;
+                    }
+                    isDirectory = S_ISDIR(st.st_mode);
+                    isSymlink = S_ISLNK(st.st_mode);
+                }
+                if (isSymlink && stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                    // Symlinks to directories are neither followed nor listed
+                    continue;
+                }
+                if (isDirectory || IsHtmlFileName(name)) {
+                    entries.push_back({name, std::move(path), isDirectory});
+                }
+            }
+            closedir(dir);
+            std::sort(entries.begin(), entries.end(), [](const TEntry& a, const TEntry& b) {
+                return a.Name < b.Name;
+            });
         }
-        if (nDocs != -1 && fileNames.size() == static_cast<size_t>(nDocs)) {
-            break;
+
+        std::unique_lock<std::mutex> lock(Mutex);
+        // Subdirectories are pushed in reverse order, so that the pool picks the ones
+        // needed next by Emit first
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+            if (it->IsDirectory) {
+                TNode& child = Nodes.emplace_back();
+                child.Path = std::move(it->Path);
+                it->Directory = &child;
+                ++PendingCount;
+                TThreadPool::Get().enqueue(TP_BULK, [this, &child] { ListTask(child); });
+            }
         }
+        node.Entries = std::move(entries);
+        node.IsListed = true;
+        HasListing.notify_all();
+        return dir != nullptr;
     }
+
+private:
+    const std::function<void(std::string&&)>& OnFile;
+    const int NDocs;
+
+    std::mutex Mutex;
+    std::condition_variable HasListing;
+    // Deque keeps node addresses stable
+    std::deque<TNode> Nodes;
+    // Listing tasks in the pool
+    size_t PendingCount = 0;
+    std::atomic<bool> IsStopped = false;
+    std::exception_ptr Error;
+
+    // Used by the calling thread only
+    size_t FilesCount = 0;
+};
+
+}
+
+void ReadFileNames(const std::string& directory, const std::function<void(std::string&&)>& onFile, int nDocs) {
+    TDirectoryWalker walker(onFile, nDocs);
+    walker.Run(directory);
+}
+
+void ReadFileNames(const std::string& directory, std::vector<std::string>& fileNames, int nDocs) {
+    ReadFileNames(directory, [&fileNames](std::string&& path) {
+        fileNames.push_back(std::move(path));
+    }, nDocs);
 }
 
 const std::regex hostRegex("(http|https)://(?:www\\.)?([^/ :]+):?([^/ ]*)(/?[^ #?]*)\\x3f?([^ #]*)#?([^ ]*)");
@@ -88,3 +273,11 @@ uint64_t DateToTimestamp(const std::string& date) {
     return timestamp > 0 ? timestamp : 0;
 }
 
+uint64_t CalcFnvHash(std::string_view data, uint64_t seed) {
+    uint64_t hash = seed;
+    for (const char c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
@@ -4,7 +4,9 @@
 
 #include <nlohmann_json/json.hpp>
 
+#include <functional>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <vector>
 #include <iostream>
@@ -60,8 +62,11 @@ T FromString(const std::string& s) {
     return nlohmann::json(s).get<T>();
 }
 
-// Read names of all files in directory
+// Read names of all .html files in directory
 void ReadFileNames(const std::string& directory, std::vector<std::string>& fileNames, int nDocs=-1);
+// Same, but the directory tree is listed in parallel and every name is passed to onFile
+// on the calling thread as soon as it is reached in DFS order with entries sorted by name
+void ReadFileNames(const std::string& directory, const std::function<void(std::string&&)>& onFile, int nDocs=-1);
 
 // Get host from url
 std::string GetHost(const std::string& url);
@@ -75,3 +80,6 @@ double Sigmoid(double x);
 
 // ISO 8601 with timezone date to timestamp
 uint64_t DateToTimestamp(const std::string& date);
+
+// 64-bit FNV-1a, pass the previous result as seed to hash several strings in a row
+uint64_t CalcFnvHash(std::string_view data, uint64_t seed = 14695981039346656037ULL);
@@ -0,0 +1,112 @@
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE "FtClassifierModule"
+
+#define STR_EXPAND(tok) #tok
+#define STR(tok) STR_EXPAND(tok)
+
+#include "../src/classifiers/ft_classifier.h"
+#include "../src/detect.h"
+#include "../src/document.h"
+#include "../src/util.h"
+#include "config.pb.h"
+
+#include <boost/test/unit_test.hpp>
+#include <fasttext.h>
+#include <google/protobuf/text_format.h>
+
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+namespace {
+
+    const std::string ROOT_PATH = STR(TEST_PATH)"/..";
+    const std::string FT_LABEL_PREFIX = "__label__";
+
+    bool FileExists(const std::string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+
+    tg::TAnnotatorConfig ReadAnnotatorConfig() {
+        std::ifstream input(ROOT_PATH + "/configs/annotator.pbtxt");
+        const std::string text((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        tg::TAnnotatorConfig config;
+        BOOST_REQUIRE(google::protobuf::TextFormat::ParseFromString(text, &config));
+        return config;
+    }
+
+    // Documents of the canonical set, empty if it is not downloaded from LFS
+    std::vector<TDocument> ReadCanonicalDocuments() {
+        std::ifstream input(STR(TEST_PATH)"/data/canonical_input.json");
+        std::vector<TDocument> documents;
+        const nlohmann::json json = nlohmann::json::parse(input, nullptr, /* allow_exceptions */ false);
+        if (!json.is_array()) {
+            return documents;
+        }
+        for (const nlohmann::json& item : json) {
+            documents.emplace_back(item);
+        }
+        return documents;
+    }
+
+    // Words of the samples used by DetectLanguage and DetectCategory, plus a few edge cases
+    std::vector<std::vector<std::string_view>> MakeSamples(const std::vector<TDocument>& documents) {
+        std::vector<std::vector<std::string_view>> samples = {{}, {"the"}, {"qwertyuiopasdfgh", "zxcvbnm"}};
+        for (const TDocument& document : documents) {
+            std::vector<std::string_view>& languageSample = samples.emplace_back();
+            TFastTextClassifier::Tokenize(document.Title, languageSample);
+            TFastTextClassifier::Tokenize(document.Description, languageSample);
+            TFastTextClassifier::Tokenize(std::string_view(document.Text).substr(0, LANGUAGE_DETECTION_TEXT_PREFIX), languageSample);
+            std::vector<std::string_view>& categorySample = samples.emplace_back();
+            TFastTextClassifier::Tokenize(document.Title, categorySample);
+            TFastTextClassifier::Tokenize(document.Text, categorySample);
+        }
+        return samples;
+    }
+
+    void CheckParity(const std::string& modelPath, const std::vector<std::vector<std::string_view>>& samples, float threshold) {
+        if (!FileExists(modelPath)) {
+            BOOST_WARN_MESSAGE(false, "Model " << modelPath << " is not downloaded, skipped");
+            return;
+        }
+        fasttext::FastText reference;
+        reference.loadModel(modelPath);
+        const TFastTextClassifier classifier(modelPath);
+
+        for (const std::vector<std::string_view>& sample : samples) {
+            std::string line;
+            for (const std::string_view token : sample) {
+                line.append(token.data(), token.size());
+                line += ' ';
+            }
+            std::istringstream stream(line);
+            std::vector<std::pair<fasttext::real, std::string>> expected;
+            reference.predictLine(stream, expected, 1, threshold);
+
+            const std::optional<TFastTextPrediction> prediction = classifier.Predict(sample, threshold);
+            BOOST_REQUIRE_EQUAL(prediction.has_value(), !expected.empty());
+            if (!prediction) {
+                continue;
+            }
+            BOOST_REQUIRE_EQUAL(FT_LABEL_PREFIX + classifier.GetLabel(prediction->LabelId), expected[0].second);
+            // Bit-exact, not approximate
+            BOOST_REQUIRE_EQUAL(prediction->Probability, expected[0].first);
+        }
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE( predict_line_parity )
+{
+    const tg::TAnnotatorConfig config = ReadAnnotatorConfig();
+    const std::vector<TDocument> documents = ReadCanonicalDocuments();
+    BOOST_WARN_MESSAGE(!documents.empty(), "Canonical input is not downloaded, only edge cases are checked");
+    const std::vector<std::vector<std::string_view>> samples = MakeSamples(documents);
+
+    CheckParity(ROOT_PATH + "/" + config.lang_detect(), samples, 0.4f);
+    for (const auto& modelConfig : config.category_models()) {
+        CheckParity(ROOT_PATH + "/" + modelConfig.path(), samples, 0.0f);
+    }
+}
@@ -0,0 +1,65 @@
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE "JsonWriterModule"
+
+#include "../src/json_writer.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+
+namespace {
+
+    nlohmann::json MakeRecord(int i) {
+        return {
+            {"title", "Title \"" + std::to_string(i) + "\"\n"},
+            {"articles", std::vector<std::string>(i % 3, "file" + std::to_string(i) + ".html")},
+            {"weight", i * 0.5},
+            {"meta", nlohmann::json::object()}
+        };
+    }
+
+    std::string WriteStreamed(int indent, int count) {
+        std::ostringstream stream;
+        TJsonStreamWriter writer(stream, indent);
+        std::vector<int> ids(count);
+        for (int i = 0; i < count; ++i) {
+            ids[i] = i;
+        }
+        writer.BeginObject();
+        writer.Key("empty");
+        writer.BeginArray();
+        writer.EndArray();
+        writer.Key("records");
+        writer.BeginArray();
+        writer.Values(ids.begin(), ids.end(), MakeRecord, 4);
+        writer.EndArray();
+        writer.Key("total");
+        writer.Value(count);
+        writer.EndObject();
+        writer.Finish();
+        return stream.str();
+    }
+
+    std::string WriteTree(int indent, int count) {
+        nlohmann::json records = nlohmann::json::array();
+        for (int i = 0; i < count; ++i) {
+            records.push_back(MakeRecord(i));
+        }
+        const nlohmann::json tree = {
+            {"empty", nlohmann::json::array()},
+            {"records", records},
+            {"total", count}
+        };
+        return tree.dump(indent) + "\n";
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE( json_writer )
+{
+    for (const int count : {0, 1, 1000}) {
+        BOOST_REQUIRE_EQUAL(WriteStreamed(4, count), WriteTree(4, count));
+        BOOST_REQUIRE_EQUAL(WriteStreamed(-1, count), WriteTree(-1, count));
+    }
+}